@@ -1,6 +1,22 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <typeindex>
+#include <utility>
 #include <boost/graph/graphviz.hpp>
+#include <boost/make_shared.hpp>
 #include "_organism.hh"
+#include "_organism_pool.hh"
 #include "_edge_wrapper.hh"
+#include "_species_store.hh"
+#include "_species_bucket.hh"
+#include "_sum_engine.hh"
+#include "_thread_pool.hh"
+#include "_interaction_csr.hh"
+#include "_vertex_wrapper.hh"
+#include "integrators/sparse_jacobian.hh"
+#include "integrators/step_controller.hh"
 
 #ifndef UTOPIA_MODELS_DOMAIN_BASE_HH
 #define UTOPIA_MODELS_DOMAIN_BASE_HH
@@ -33,11 +49,94 @@ protected:
      */
     int oid = 0;
 
-    template<int N>
-    void calculate_sums();
+    /**
+     * @brief Rebuild the trait indices of all buckets
+     * @details Needed if slots are renumbered, the tolerance changed or a new type appeared
+     *
+     */
+    void rebuild_trait_index();
+
+    /**
+     * @brief Add slot i to the trait index of its bucket
+     *
+     * @param i
+     */
+    void index_slot(std::size_t i);
+
+    /**
+     * @brief Topology version
+     * @details Incremented whenever species or edges are added
+     *
+     */
+    std::size_t topology_version = 0;
+
+    /**
+     * @brief Topology version the CSR snapshot was built for
+     *
+     */
+    std::size_t csr_version = std::numeric_limits<std::size_t>::max();
+
+    /**
+     * @brief Versions the active edge list was built for
+     * @details Topology version and active version of the species store
+     *
+     */
+    std::pair<std::size_t, std::size_t> active_edges_version = {std::numeric_limits<std::size_t>::max(), 0};
+
+    /**
+     * @brief Versions the derivatives of the last stage were evaluated for
+     * @details Topology version and active version of the species store. Integrators
+     *          with first same as last reuse them only if nothing changed since.
+     *
+     */
+    std::pair<std::size_t, std::size_t> fsal_version = {std::numeric_limits<std::size_t>::max(), 0};
+
+    /**
+     * @brief Step Size Controller
+     * @details Accepts or rejects the steps of adaptive integrators
+     *
+     */
+    step_controller controller;
+
+    /**
+     * @brief Values and first derivatives at the start of the step
+     * @details A rejected step is repeated from these
+     *
+     */
+    std::vector<CURRENCY> x_start;
+    std::vector<CURRENCY> k_start;
+
+    /**
+     * @brief Active slots without the ones going extinct in this step
+     *
+     */
+    std::vector<char> norm_mask;
+
+    /**
+     * @brief Size of the last accepted step
+     *
+     */
+    double last_dt = 0.0;
+
+    /**
+     * @brief Jacobian of the community
+     * @details Only used by implicit integrators
+     *
+     */
+    sparse_jacobian<CURRENCY> jacobian;
+
+    /**
+     * @brief Accepted steps before the Jacobian is evaluated again
+     *
+     */
+    std::size_t jacobian_interval = 10;
 
-    template<int N, int MAX>
-    void calculate_all_sums_iter();
+    /**
+     * @brief Derivatives for the finite differences of the Jacobian
+     *
+     */
+    std::vector<CURRENCY> f0;
+    std::vector<CURRENCY> f1;
 
     /*
      * @brief time of the simulation
@@ -65,6 +164,24 @@ public:
     // map parameters space to vertex to avoid multiple species with same properties
     using parameter_space_map = boost::unordered_map<PSPACE_T, vertex_desc_t, hash_t>;
 
+    // structure-of-arrays store of all species
+    using store_t = species_store<CURRENCY, typename PSPACE_T::trait_t>;
+
+    // organism type on the vertices
+    using org_t = typename vertex_organism<VERTEX_T>::type;
+
+    // flat copy of the edges
+    using csr_t = interaction_csr<edge_cont>;
+
+    // kernels for all species of one type
+    using bucket_t = species_bucket_base<domain_base>;
+
+    // alternative to the sums over the edges
+    using engine_t = sum_engine<domain_base>;
+
+    // number of sum levels
+    static constexpr std::size_t sum_size = SUM_SIZE;
+
     /**
      * @brief Construct a new domain base object
      * 
@@ -86,6 +203,57 @@ public:
      */
     double bm_threshold = 0.05;
 
+    /**
+     * @brief Block Layout
+     * @details If set, compact() groups the slots by species type, so every type
+     *          occupies a contiguous block of the species store
+     * 
+     */
+    bool block_layout = false;
+
+    /**
+     * @brief Parallel Threshold
+     * @details Minimum number of candidate pairs (or species for gathered sums)
+     *          before the work is spread over the thread pool
+     * 
+     */
+    std::size_t parallel_threshold = 256;
+
+    /**
+     * @brief Gather Sums
+     * @details If set, every species collects its sums from its out and in edges
+     *          instead of writing into its partners. Runs on the thread pool, the
+     *          summation order differs from the default scatter pass. Levels are
+     *          never fused in this mode.
+     * 
+     */
+    bool gather = false;
+
+    /**
+     * @brief Fused Stages
+     * @details If set, buckets that allow it compute sums, derivative and stage update
+     *          in one sweep before the remaining buckets run the usual passes.
+     *          Not used with gathered sums.
+     * 
+     */
+    bool fused_stages = false;
+
+    /**
+     * @brief Sum Engine
+     * @details If set and applicable, computes the sums of every stage instead of
+     *          the passes over the edges. Empty by default.
+     * 
+     */
+    std::unique_ptr<engine_t> engine;
+
+    /**
+     * @brief Organism Arenas
+     * @details One arena per species type. Declared before the graph
+     *          so organisms are released before their arena.
+     * 
+     */
+    boost::unordered_map<std::type_index, std::shared_ptr<organism_arena> > arenas;
+
     /**
      * @brief Food Network
      * 
@@ -99,6 +267,84 @@ public:
      */
     parameter_space_map psm;
 
+    /**
+     * @brief Species Store
+     * @details Contiguous per species data (biomass, stage values, sums, traits, ...).
+     *          Vertices and integrators are views on their slot in the store.
+     * 
+     */
+    store_t species;
+
+    /**
+     * @brief Vertex of every slot in the species store
+     * 
+     */
+    std::vector<vertex_desc_t> slot_vertex;
+
+    /**
+     * @brief Organism of every slot in the species store
+     * 
+     */
+    std::vector<org_t*> slot_org;
+
+    /**
+     * @brief Key of every slot in the parameter space map
+     * @details The parameters of an organism can drift from it, e.g. the carrying
+     *          capacity of producers with a time dependent environment
+     * 
+     */
+    std::vector<PSPACE_T> slot_key;
+
+    /**
+     * @brief Interaction Matrix
+     * @details Compressed sparse row snapshot of the edges in slot indices.
+     *          Rebuilt from the graph only if the topology changed.
+     * 
+     */
+    csr_t interactions;
+
+    /**
+     * @brief Species Buckets
+     * @details One bucket per species type in order of first use. Each holds the active
+     *          species of its type and the active edges leaving them (edges between active
+     *          species), split into blocks by target type. Rebuilt if the topology or the
+     *          set of active species changed.
+     * 
+     */
+    std::vector<std::unique_ptr<bucket_t> > buckets;
+
+    /**
+     * @brief Bucket of every species type
+     * 
+     */
+    boost::unordered_map<std::type_index, std::size_t> bucket_index;
+
+    /**
+     * @brief Bucket of every slot in the species store
+     * 
+     */
+    std::vector<std::size_t> slot_bucket;
+
+    /**
+     * @brief Interacting pairs of buckets
+     * @details Entry a * buckets.size() + b has bit 1 set if species of bucket a can
+     *          interact with bucket b and bit 2 for the other direction.
+     *          Built from the interacts_with() declarations of the species classes.
+     * 
+     */
+    std::vector<unsigned char> pair_table;
+
+    /**
+     * @brief Interacting directions of a pair of buckets
+     * 
+     * @param a 
+     * @param b 
+     * @return unsigned char See pair_table
+     */
+    [[nodiscard]] unsigned char pair_mask(std::size_t a, std::size_t b) const {
+        return this->pair_table[a * this->buckets.size() + b];
+    }
+
     /**
      * @brief Add a species of type ORG_T
      * 
@@ -121,19 +367,174 @@ public:
     template <typename ORG_T>
     VERTEX_T& add_(currency mass, PSPACE_T ps);
 
+    /**
+     * @brief Change the parameters of a species
+     * @details Re-keys the parameter space map and the trait index and rebuilds the
+     *          edges of the species only: its old edges are found through the candidate
+     *          window, the new ones like in add_edges() but against all slots.
+     *          The type cannot change. Not allowed during a batch insertion.
+     * 
+     * @param v The species
+     * @param ps New parameter space
+     * @return VERTEX_T& 
+     */
+    VERTEX_T& set_parameters(vertex_desc_t v, PSPACE_T ps);
+
+    /**
+     * @brief Change the trait of a species
+     * @details See set_parameters()
+     * 
+     * @param v The species
+     * @param trait New trait
+     * @return VERTEX_T& 
+     */
+    VERTEX_T& set_trait(vertex_desc_t v, const typename PSPACE_T::trait_t& trait);
+
+    /**
+     * @brief Get the arena for objects of type T
+     * @details Creates the arena on first use
+     * 
+     * @tparam T Species type (or any other type to pool)
+     * @return std::shared_ptr<organism_arena>& 
+     */
+    template <typename T>
+    std::shared_ptr<organism_arena>& get_arena();
+
+    /**
+     * @brief Get the bucket for species of type ORG_T
+     * @details Creates the bucket on first use
+     * 
+     * @tparam ORG_T Species type
+     * @return std::size_t Index into buckets
+     */
+    template <typename ORG_T>
+    std::size_t get_bucket();
+
     /**
      * @brief Calculate sums depending on graph
      */
     inline void calculate_all_sums();
 
+    /**
+     * @brief One stage with the fused buckets first
+     * @details Fused buckets sum, step and update in one sweep, the others follow
+     *          with the level-wise sum pass and their step
+     *
+     * @param dt
+     * @param last Last substep
+     * @param new_dt
+     * @param extinct
+     */
+    void fused_stage(double dt, bool last, double& new_dt, std::vector<std::size_t>& extinct);
+
+    /**
+     * @brief All stages of one step of dt
+     * @details Species go extinct only if the step is accepted
+     *
+     * @param dt
+     * @param new_dt
+     * @return bool Step accepted
+     */
+    bool attempt_step(double dt, double& new_dt);
+
+    /**
+     * @brief Derivatives of all active species at the current stage values
+     * @details Sums with the engine if it applies, otherwise over the edges
+     *
+     * @param out Derivative of every slot
+     */
+    void evaluate_derivatives(CURRENCY* out);
+
+    /**
+     * @brief Evaluate the Jacobian if it is outdated
+     * @details The pattern follows the active edges and is rebuilt if the topology
+     *          or the active species changed. The entries are finite differences,
+     *          one perturbation per color, at the start of the step.
+     */
+    void update_jacobian();
+
+    /**
+     * @brief Rebuild the interaction matrix if the topology changed
+     */
+    void update_interactions();
+
+    /**
+     * @brief Rebuild the active lists of the buckets if the topology or the active species changed
+     * @details Only the rows of active species are visited
+     */
+    void update_active_edges();
+
+    /**
+     * @brief Build the transposed blocks of the buckets from their blocks
+     */
+    void transpose_active_edges();
+
+    /**
+     * @brief Get the topology version
+     * @details Changes whenever species or edges are added
+     *
+     * @return std::size_t
+     */
+    [[nodiscard]] std::size_t get_topology_version() const {
+        return this->topology_version;
+    }
+
     /**
      * @brief Perform one time_step of dt
+     * @details A step rejected by the step controller is repeated with a smaller one,
+     *          the size of the step taken is get_last_dt()
      * 
      * @param dt Time Step
      * @return double New Time Step (adaptive Time step)
      */
     double step(double dt);
 
+    /**
+     * @brief Size of the last step taken
+     *
+     * @return double
+     */
+    [[nodiscard]] double get_last_dt() const {
+        return this->last_dt;
+    }
+
+    /**
+     * @brief Remove long extinct species
+     * @details Drops species that are inactive for at least min_age from the graph,
+     *          the parameter space map and the species store. Ids of the remaining
+     *          species are kept, their slots are renumbered in order (grouped by type
+     *          with block_layout).
+     *
+     * @param min_age Minimal time since extinction
+     * @return std::size_t Number of removed species
+     */
+    std::size_t compact(double min_age = 0.0);
+
+    /**
+     * @brief Fraction of inactive species
+     *
+     * @return double
+     */
+    [[nodiscard]] double get_dead_fraction() const;
+
+    /**
+     * @brief Start a batch insertion
+     * @details Species added until end_batch() are inserted into the graph, the
+     *          parameter space map and the species store right away, but their
+     *          edges are built together by end_batch(). Do not step or compact
+     *          the domain in between.
+     */
+    void begin_batch();
+
+    /**
+     * @brief Finish a batch insertion
+     * @details Builds the edges of all species added since begin_batch() against
+     *          the community and among each other, with one trait index scan per
+     *          overlapping group of candidate windows. The resulting edges are
+     *          the same as with one add_edges() per species.
+     */
+    void end_batch();
+
     /**
      * @brief Set the Interaction Tolerance
      * 
@@ -148,6 +549,77 @@ public:
      */
     void set_bm_threshold(double new_threshold);
 
+    /**
+     * @brief Set the Block Layout
+     * 
+     * @param b 
+     */
+    void set_block_layout(bool b);
+
+    /**
+     * @brief Set the Number of Threads for the edge construction
+     * @details The interaction coefficients of the candidates are evaluated in
+     *          parallel, the edges are added in the serial order afterwards.
+     *          calc_interaction_coeff must be safe to call concurrently.
+     * 
+     * @param n Number of threads, 1 or less is serial
+     */
+    void set_threads(std::size_t n);
+
+    /**
+     * @brief Set gathered sums
+     * 
+     * @param b 
+     */
+    void set_gather_sums(bool b);
+
+    /**
+     * @brief Set fused stages
+     * 
+     * @param b 
+     */
+    void set_fused_stages(bool b);
+
+    /**
+     * @brief Set the sum engine
+     * 
+     * @param e Engine, empty to always sum over the edges
+     */
+    void set_sum_engine(std::unique_ptr<engine_t> e);
+
+    /**
+     * @brief Set the step size controller
+     * 
+     * @param c 
+     */
+    void set_step_controller(const step_controller& c);
+
+    /**
+     * @brief Get the step size controller
+     * 
+     * @return const step_controller& 
+     */
+    const step_controller& get_step_controller() const {
+        return this->controller;
+    }
+
+    /**
+     * @brief Set the number of accepted steps the Jacobian is reused for
+     * @details Implicit integrators only. A rejected step always triggers a new evaluation.
+     * 
+     * @param n At least 1
+     */
+    void set_jacobian_interval(std::size_t n);
+
+    /**
+     * @brief Get the Jacobian of the community
+     * 
+     * @return const sparse_jacobian<CURRENCY>& 
+     */
+    const sparse_jacobian<CURRENCY>& get_jacobian() const {
+        return this->jacobian;
+    }
+
     /**
      * @brief Access vertex v
      * 
@@ -231,6 +703,19 @@ public:
 
 protected:
 
+    /**
+     * @brief Batch insertion is running
+     *
+     */
+    bool batching = false;
+
+    /**
+     * @brief Species added during the batch, in order
+     * @details Their edges are built by end_batch()
+     *
+     */
+    std::vector<vertex_desc_t> pending;
+
     /**
      * @brief Add edges to given vertex
      * 
@@ -238,17 +723,83 @@ protected:
      */
     void add_edges(vertex_desc_t reference);
 
-};
+    /**
+     * @brief Radius of the candidate window of a species in a bucket
+     * @details Covers both directions, negative if no interaction is possible
+     * 
+     * @param i Slot of the species
+     * @param bucket 
+     * @return double 
+     */
+    double window_radius(std::size_t i, const bucket_t& bucket) const;
 
-template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
-domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::domain_base() = default;
+    /**
+     * @brief Pair of a vertex and a candidate
+     * @details z1 is the coefficient of ref with other, z2 the other way round
+     *
+     */
+    struct candidate_pair {
+        std::size_t ref;
+        std::size_t other;
+        edge_cont z1;
+        edge_cont z2;
+    };
 
-// Take an initial mass and a parameter space to add species
-template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
-template <typename ORG_T>
-VERTEX_T& domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::add_(currency mass, PSPACE_T ps) {
+    /**
+     * @brief Thread pool for the edge construction
+     * @details Empty if serial
+     *
+     */
+    std::unique_ptr<thread_pool> pool;
 
-    ps.type = ORG_T::type_id;
+    /**
+     * @brief Collect the pairs of a vertex and its candidates
+     * @details By default only candidates in older slots are considered, newer ones
+     *          connect to the vertex when they are added themselves.
+     * 
+     * @param reference The Vertex
+     * @param candidates Candidate slots, sorted in place
+     * @param pairs Pairs are appended in the order of the full scan
+     * @param older_only Skip candidates in newer slots
+     */
+    void collect(vertex_desc_t reference, std::vector<std::size_t>& candidates, std::vector<candidate_pair>& pairs,
+                 bool older_only = true) const;
+
+    /**
+     * @brief Candidate slots of a species from the trait index
+     * 
+     * @param i Slot of the species
+     * @param candidates Slots are appended
+     */
+    void candidates_of(std::size_t i, std::vector<std::size_t>& candidates) const;
+
+    /**
+     * @brief Calculate the interaction coefficients of all pairs
+     * @details Runs on the thread pool for large numbers of pairs. The coefficients
+     *          of a vertex with its candidates are evaluated as one batch.
+     * 
+     * @param pairs 
+     */
+    void evaluate(std::vector<candidate_pair>& pairs);
+
+    /**
+     * @brief Add the accepted edges in the order of the pairs
+     * 
+     * @param pairs 
+     */
+    void connect(const std::vector<candidate_pair>& pairs);
+
+};
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::domain_base() = default;
+
+// Take an initial mass and a parameter space to add species
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+template <typename ORG_T>
+VERTEX_T& domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::add_(currency mass, PSPACE_T ps) {
+
+    ps.type = ORG_T::type_id;
 
     // insert pair in map
     auto iter_ins_pair = this->psm.insert(std::make_pair(ps, vertex_desc_t()));
@@ -263,14 +814,46 @@ VERTEX_T& domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::ad
 
         VERTEX_T& tmp_vertex = this->graph[v];
 
+        // before the new slot exists, a new bucket reindexes all slots
+        const std::size_t bucket = this->template get_bucket<ORG_T>();
+
         // And set
         tmp_vertex.id = oid;
-        tmp_vertex.org = boost::make_shared<ORG_T>(static_cast<DOM_T*>(this), mass);
+        // organisms of the same type share an arena
+        tmp_vertex.org = boost::allocate_shared<ORG_T>(pool_allocator<ORG_T>(this->template get_arena<ORG_T>()),
+                                                       static_cast<DOM_T*>(this), mass);
 
         tmp_vertex.org->parameters = ps;
+        tmp_vertex.org->update_constants();
+
+        // The integrator of the organism allocated a new slot in the species store
+        tmp_vertex.store = &this->species;
+        tmp_vertex.idx = tmp_vertex.org->integrator.get_index();
+
+        this->species.trait[tmp_vertex.idx] = ps.trait;
+        this->species.type[tmp_vertex.idx] = ps.type;
+
+        if (this->slot_vertex.size() <= tmp_vertex.idx) {
+            this->slot_vertex.resize(tmp_vertex.idx + 1);
+            this->slot_org.resize(tmp_vertex.idx + 1);
+            this->slot_key.resize(tmp_vertex.idx + 1);
+            this->slot_bucket.resize(tmp_vertex.idx + 1);
+        }
+        this->slot_vertex[tmp_vertex.idx] = v;
+        this->slot_org[tmp_vertex.idx] = tmp_vertex.org.get();
+        this->slot_key[tmp_vertex.idx] = ps;
+        this->slot_bucket[tmp_vertex.idx] = bucket;
+
+        this->index_slot(tmp_vertex.idx);
+
+        this->topology_version++;
 
         // calculate the edges from and to the new species
-        this->add_edges(v);
+        if (this->batching) {
+            this->pending.push_back(v);
+        } else {
+            this->add_edges(v);
+        }
 
         // increment id
         oid++;
@@ -288,8 +871,8 @@ VERTEX_T& domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::ad
 
         tmp_vertex.set_mass(tmp_vertex.get_mass() + mass);
 
-        if (!tmp_vertex.active){
-            tmp_vertex.active = true;
+        if (!tmp_vertex.is_active()){
+            tmp_vertex.set_active(true);
             tmp_vertex.org->count(1);
         }
 
@@ -306,39 +889,202 @@ VERTEX_T& domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::ad
 
 }
 
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+template <typename T>
+std::shared_ptr<organism_arena>& domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::get_arena() {
+
+    auto& arena = this->arenas[std::type_index(typeid(T))];
+
+    if (!arena) {
+        arena = std::make_shared<organism_arena>();
+    }
+
+    return arena;
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+template <typename ORG_T>
+std::size_t domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::get_bucket() {
+
+    auto iter_ins_pair = this->bucket_index.insert(std::make_pair(std::type_index(typeid(ORG_T)), this->buckets.size()));
+
+    if (iter_ins_pair.second) {
+        this->buckets.push_back(std::make_unique<species_bucket<domain_base, ORG_T> >());
+        this->buckets.back()->type = ORG_T::type_id;
+
+        const std::size_t n = this->buckets.size();
+
+        this->pair_table.assign(n * n, 0);
+        for (std::size_t a = 0; a < n; ++a) {
+            for (std::size_t b = 0; b < n; ++b) {
+                this->pair_table[a * n + b] = (this->buckets[a]->interacts_with(this->buckets[b]->type) ? 1 : 0)
+                                            | (this->buckets[b]->interacts_with(this->buckets[a]->type) ? 2 : 0);
+            }
+        }
+
+        // fused stages only for types no one has edges into
+        for (std::size_t b = 0; b < n; ++b) {
+            this->buckets[b]->stage_fused = this->buckets[b]->can_fuse_stage();
+            for (std::size_t a = 0; a < n; ++a) {
+                if (this->pair_mask(a, b) & 1) {
+                    this->buckets[b]->stage_fused = false;
+                }
+            }
+        }
+
+        // radii of the existing species towards the new type
+        this->rebuild_trait_index();
+    }
+
+    return iter_ins_pair.first->second;
+}
+
 // method to add edges from and to a species
 template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
 void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::add_edges(vertex_desc_t reference) {
 
 
-    edge_cont z1, z2;
+    // candidates: species within the interaction radius of either side
+    std::vector<std::size_t> candidates;
+
+    this->candidates_of(this->graph[reference].idx, candidates);
+
+    std::vector<candidate_pair> pairs;
+
+    this->collect(reference, candidates, pairs);
+    this->evaluate(pairs);
+    this->connect(pairs);
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::candidates_of(std::size_t i, std::vector<std::size_t>& candidates) const {
+
+    const double t = this->species.trait[i][0];
+
+    for (auto& bucket : this->buckets) {
+        const double r = this->window_radius(i, *bucket);
+
+        // no interaction in either direction
+        if (r < 0.0) {
+            continue;
+        }
+
+        bucket->index_query(t - r, t + r, candidates);
+    }
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+double domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::window_radius(std::size_t i, const bucket_t& bucket) const {
+
+    return std::max(this->slot_org[i]->interaction_radius(this->interaction_tolerance, bucket.type),
+                    bucket.get_max_radius(this->species.type[i]));
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::collect(vertex_desc_t reference, std::vector<std::size_t>& candidates, std::vector<candidate_pair>& pairs,
+                                                                                  bool older_only) const {
+
+    const std::size_t i_ref = this->graph[reference].idx;
+
+    // keep the order of the full scan
+    std::sort(candidates.begin(), candidates.end());
 
-    // iterate over all organisms
-    for (auto v : this->get_vertices() ) {
+    for (auto j : candidates) {
+
+        // newer species connect themselves
+        if (older_only && j > i_ref) {
+            break;
+        }
+
+        // types that cannot interact
+        if (this->pair_mask(this->slot_bucket[i_ref], this->slot_bucket[j]) == 0) {
+            continue;
+        }
+
+        pairs.push_back({i_ref, j, {}, {}});
+    }
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::evaluate(std::vector<candidate_pair>& pairs) {
+
+    // every pair is written by exactly one thread
+    auto calc = [&](std::size_t begin, std::size_t end) {
+
+        thread_local std::vector<const org_t*> others;
+        thread_local std::vector<std::size_t> index;
+        thread_local std::vector<edge_cont> z;
+
+        // pairs of one reference are contiguous, its coefficients are evaluated as a batch
+        for (std::size_t first = begin; first < end;) {
+
+            const std::size_t ref = pairs[first].ref;
+            const std::size_t a = this->slot_bucket[ref];
+
+            others.clear();
+            index.clear();
+
+            std::size_t k = first;
+            for (; k < end && pairs[k].ref == ref; ++k) {
+                const unsigned char mask = this->pair_mask(a, this->slot_bucket[pairs[k].other]);
+
+                if (mask & 1) {
+                    others.push_back(this->slot_org[pairs[k].other]);
+                    index.push_back(k);
+                }
+
+                // the partner with the reference
+                if (mask & 2) {
+                    this->buckets[a]->coeffs(*this->slot_org[ref], *this->slot_org[pairs[k].other],
+                                             2, pairs[k].z1, pairs[k].z2);
+                }
+            }
+
+            z.resize(others.size());
+            this->buckets[a]->coeffs_batch(*this->slot_org[ref], others.data(), others.size(), z.data());
+
+            for (std::size_t i = 0; i < index.size(); ++i) {
+                pairs[index[i]].z1 = z[i];
+            }
+
+            first = k;
+        }
+    };
+
+    if (this->pool && pairs.size() >= this->parallel_threshold) {
+        this->pool->parallel_for(pairs.size(), calc);
+    } else {
+        calc(0, pairs.size());
+    }
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::connect(const std::vector<candidate_pair>& pairs) {
 
-        // call the interaction coefficient method of the species with every other species
-        z1 = this->graph[reference].org->calc_interaction_coeff(this->graph[v].org);
+    for (const auto& pair : pairs) {
+
+        vertex_desc_t reference = this->slot_vertex[pair.ref];
+        vertex_desc_t v = this->slot_vertex[pair.other];
 
         // accepts the interaction if the value exceeds a threshold
-        for (auto const &i: z1) {
+        for (auto const &i: pair.z1) {
             if (i > this->interaction_tolerance) {
 
                 // add the edge
-                add_edge(reference, v, {z1}, this->graph);
+                add_edge(reference, v, {pair.z1}, this->graph);
+                this->topology_version++;
                 break;
             }
         }
 
-        // do the same the other way round (asymmetrical)
-        z2 = this->graph[v].org->calc_interaction_coeff(this->graph[reference].org);
-
         // avoid two edges to the organism itself
         if ( reference != v ){
-            for (auto const &i: z2) {
+            for (auto const &i: pair.z2) {
                 if ( i > this->interaction_tolerance ) {
 
                     // add edge
-                    add_edge(v, reference, {z2}, this->graph);
+                    add_edge(v, reference, {pair.z2}, this->graph);
+                    this->topology_version++;
                     break;
 
                 }
@@ -349,109 +1095,722 @@ void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::add_edg
 }
 
 template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
-template<int N>
-void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::calculate_sums() {
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::begin_batch() {
+
+    this->batching = true;
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::end_batch() {
+
+    this->batching = false;
+
+    if (this->pending.empty()) {
+        return;
+    }
+
+    // candidates of every pending species
+    std::vector<std::vector<std::size_t> > candidates(this->pending.size());
+
+    struct window {
+        double lo;
+        double hi;
+        std::size_t p;
+    };
+
+    std::vector<window> windows;
+    std::vector<std::pair<double, std::size_t> > region;
+
+    for (auto& bucket : this->buckets) {
 
-    vertex_desc_t vertex1;
+        windows.clear();
 
-    for (auto v: this->get_vertices() ) {
+        for (std::size_t p = 0; p < this->pending.size(); ++p) {
 
-        VERTEX_T &vertex2 = this->graph[v];
+            const std::size_t i = this->graph[this->pending[p]].idx;
+            const double r = this->window_radius(i, *bucket);
 
-        if (!vertex2.active) {
+            if (r >= 0.0) {
+                const double t = this->species.trait[i][0];
+                windows.push_back({t - r, t + r, p});
+            }
+        }
+
+        if (windows.empty()) {
             continue;
         }
 
-        // iterate over all edges
-        for (auto e : this->get_out_edges(v) ) {
+        std::sort(windows.begin(), windows.end(), [](const window& a, const window& b){ return a.lo < b.lo; });
 
-            vertex1 = target(e, this->graph);
+        // scan the index once per group of overlapping windows
+        region.clear();
 
-            if (!this->graph[vertex1].active) {
-                continue;
+        double lo = windows.front().lo;
+        double hi = windows.front().hi;
+
+        for (const auto& w : windows) {
+            if (w.lo > hi) {
+                bucket->index_range(lo, hi, region);
+                lo = w.lo;
             }
+            hi = std::max(hi, w.hi);
+        }
+        bucket->index_range(lo, hi, region);
 
-            // Add the edge values to the vertex
-            vertex2.org->template add_edge_cont<N>(this->graph[e].interaction_vector, this->graph[vertex1].org);
+        // the groups are disjoint and ascending, so region is sorted
+        for (const auto& w : windows) {
+            auto first = std::lower_bound(region.begin(), region.end(), std::make_pair(w.lo, std::size_t(0)));
+            auto last = std::upper_bound(first, region.end(), std::make_pair(w.hi, std::numeric_limits<std::size_t>::max()));
 
+            for (auto it = first; it != last; ++it) {
+                candidates[w.p].push_back(it->second);
+            }
         }
     }
+
+    // pairs in order of insertion, evaluated together
+    std::vector<candidate_pair> pairs;
+
+    for (std::size_t p = 0; p < this->pending.size(); ++p) {
+        this->collect(this->pending[p], candidates[p], pairs);
+    }
+
+    this->evaluate(pairs);
+    this->connect(pairs);
+
+    this->pending.clear();
 }
 
 template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
-template<int N, int MAX>
-void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::calculate_all_sums_iter() {
-    if constexpr ( N == MAX ) {
+VERTEX_T& domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_parameters(vertex_desc_t v, PSPACE_T ps) {
+
+    if (this->batching) {
+        throw std::logic_error("Parameters can't change during a batch insertion");
+    }
+
+    VERTEX_T& vertex = this->graph[v];
+    const std::size_t i = vertex.idx;
+
+    ps.type = this->slot_key[i].type;
+
+    if (ps == this->slot_key[i]) {
+        return vertex;
+    }
+
+    if (this->psm.find(ps) != this->psm.end()) {
+        throw std::invalid_argument("A species with these parameters already exists");
+    }
+
+    // edges into the species from the snapshot, the candidate window may have
+    // shrunk since they were added
+    this->update_interactions();
+
+    for (std::size_t k = 0; k < this->interactions.size(); ++k) {
+        const std::size_t j = this->interactions.source[k];
+        if (this->interactions.target[k] == i && j != i) {
+            remove_edge(this->slot_vertex[j], v, this->graph);
+        }
+    }
+    clear_out_edges(v, this->graph);
+
+    this->buckets[this->slot_bucket[i]]->index_erase(this->species.trait[i][0], i);
+    this->psm.erase(this->slot_key[i]);
+
+    vertex.org->parameters = ps;
+    vertex.org->update_constants();
+    this->species.trait[i] = ps.trait;
+
+    this->psm.insert(std::make_pair(ps, v));
+    this->slot_key[i] = ps;
+    this->index_slot(i);
+
+    // edges with all species, older and newer
+    std::vector<std::size_t> candidates;
+    this->candidates_of(i, candidates);
+
+    std::vector<candidate_pair> pairs;
+
+    this->collect(v, candidates, pairs, false);
+    this->evaluate(pairs);
+    this->connect(pairs);
+
+    this->topology_version++;
+
+    return vertex;
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+VERTEX_T& domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_trait(vertex_desc_t v, const typename PSPACE_T::trait_t& trait) {
+
+    PSPACE_T ps = this->slot_key[this->graph[v].idx];
+    ps.trait = trait;
+
+    return this->set_parameters(v, ps);
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::update_interactions() {
+
+    if (this->csr_version == this->topology_version) {
         return;
-    } else {
-        this->template calculate_sums<N>();
-        this->calculate_all_sums_iter<N + 1, MAX>();
+    }
+
+    this->interactions.clear();
+
+    for (std::size_t i = 0; i < this->slot_vertex.size(); ++i) {
+
+        this->interactions.begin_row();
+
+        for (auto e : this->get_out_edges(this->slot_vertex[i]) ) {
+            this->interactions.push_back(i,
+                                         this->graph[target(e, this->graph)].idx,
+                                         this->graph[e].interaction_vector);
+        }
+    }
+
+    this->interactions.finish();
+
+    this->csr_version = this->topology_version;
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::update_active_edges() {
+
+    const std::pair<std::size_t, std::size_t> version = {this->csr_version, this->species.active_version};
+
+    if (this->active_edges_version == version) {
+        return;
+    }
+
+    const auto& active = this->species.active;
+
+    for (auto& bucket : this->buckets) {
+        bucket->clear();
+        bucket->blocks.resize(this->buckets.size());
+        bucket->in_blocks.resize(this->gather ? this->buckets.size() : 0);
+    }
+
+    for (auto i : this->species.active_slots) {
+
+        auto& bucket = *this->buckets[this->slot_bucket[i]];
+
+        bucket.active_slots.push_back(i);
+
+        for (auto& block : bucket.blocks) {
+            block.begin_row();
+        }
+
+        for (std::size_t k = this->interactions.row[i]; k < this->interactions.row[i + 1]; ++k) {
+
+            const std::size_t t = this->interactions.target[k];
+
+            if (active[t]) {
+                bucket.blocks[this->slot_bucket[t]].push_back(i, t, this->interactions.weight[k]);
+            }
+        }
+    }
+
+    for (auto& bucket : this->buckets) {
+        for (auto& block : bucket->blocks) {
+            block.finish();
+        }
+    }
+
+    if (this->gather) {
+        this->transpose_active_edges();
+    }
+
+    this->active_edges_version = version;
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::transpose_active_edges() {
+
+    // row of every active slot in its bucket
+    std::vector<std::size_t> row(this->species.size());
+
+    for (auto& bucket : this->buckets) {
+        for (std::size_t r = 0; r < bucket->active_slots.size(); ++r) {
+            row[bucket->active_slots[r]] = r;
+        }
+    }
+
+    // counting sort of the out blocks of a by target
+    for (std::size_t a = 0; a < this->buckets.size(); ++a) {
+        for (std::size_t b = 0; b < this->buckets.size(); ++b) {
+
+            const auto& out = this->buckets[a]->blocks[b];
+            auto& in = this->buckets[b]->in_blocks[a];
+
+            in.row.assign(this->buckets[b]->active_slots.size() + 1, 0);
+            for (auto t : out.target) {
+                in.row[row[t] + 1]++;
+            }
+            for (std::size_t r = 1; r < in.row.size(); ++r) {
+                in.row[r] += in.row[r - 1];
+            }
+
+            in.source.resize(out.size());
+            in.target.resize(out.size());
+            in.weight.resize(out.size());
+
+            // sources are visited in ascending order
+            std::vector<std::size_t> pos(in.row.begin(), in.row.end() - 1);
+            for (std::size_t k = 0; k < out.size(); ++k) {
+                const std::size_t p = pos[row[out.target[k]]]++;
+                in.source[p] = out.source[k];
+                in.target[p] = out.target[k];
+                in.weight[p] = out.weight[k];
+            }
+        }
     }
 }
 
 template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
 inline void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::calculate_all_sums() {
-    this->calculate_all_sums_iter<0, SUM_SIZE>();
+    this->update_interactions();
+    this->update_active_edges();
+
+    // finish each level for all species before the next one
+    for (std::size_t n = 0; n < SUM_SIZE; ++n) {
+        for (auto& bucket : this->buckets) {
+
+            if (!this->gather) {
+                bucket->calculate_sums(*this, n);
+                continue;
+            }
+
+            // every species only writes its own sums
+            auto gather_rows = [&](std::size_t begin, std::size_t end) {
+                bucket->gather_sums(*this, n, begin, end);
+            };
+
+            const std::size_t rows = bucket->active_slots.size();
+
+            if (this->pool && rows >= this->parallel_threshold) {
+                this->pool->parallel_for(rows, gather_rows);
+            } else {
+                gather_rows(0, rows);
+            }
+        }
+    }
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::evaluate_derivatives(CURRENCY* out) {
+
+    bool engine_sums = false;
+
+    if (this->engine) {
+        this->update_interactions();
+        this->update_active_edges();
+
+        engine_sums = this->engine->calculate_sums(*this);
+    }
+
+    if (!engine_sums) {
+        this->calculate_all_sums();
+    }
+
+    for (auto& bucket : this->buckets) {
+        bucket->evaluate(*this, out);
+    }
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::update_jacobian() {
+
+    const std::pair<std::size_t, std::size_t> version = {this->topology_version, this->species.active_version};
+
+    if (this->jacobian.version != version) {
+        this->update_interactions();
+
+        const auto& active = this->species.active;
+
+        // derivatives depend on the partners of the active edges, sums of sums are left out
+        std::vector<std::pair<std::size_t, std::size_t> > pairs;
+        for (auto i : this->species.active_slots) {
+            for (std::size_t k = this->interactions.row[i]; k < this->interactions.row[i + 1]; ++k) {
+                const std::size_t t = this->interactions.target[k];
+                if (active[t] && t != i) {
+                    pairs.emplace_back(i, t);
+                }
+            }
+        }
+
+        this->jacobian.set_pattern(this->species.size(), pairs, active);
+        this->jacobian.version = version;
+    }
+
+    if (this->jacobian.age < this->jacobian_interval) {
+        return;
+    }
+
+    const std::size_t n = this->species.size();
+    this->f0.assign(n, 0.0);
+    this->f1.assign(n, 0.0);
+
+    this->evaluate_derivatives(this->f0.data());
+
+    auto& x = this->species.xs[0];
+    std::vector<CURRENCY> x_old;
+    std::vector<CURRENCY> h;
+
+    for (std::size_t c = 0; c < this->jacobian.n_colors(); ++c) {
+
+        const auto& slots = this->jacobian.color(c);
+
+        x_old.resize(slots.size());
+        h.resize(slots.size());
+
+        for (std::size_t q = 0; q < slots.size(); ++q) {
+            const std::size_t j = slots[q];
+            x_old[q] = x[j];
+            x[j] += std::sqrt(std::numeric_limits<CURRENCY>::epsilon()) * std::max(std::fabs(x[j]), CURRENCY(1.0));
+            // the step that is representable
+            h[q] = x[j] - x_old[q];
+        }
+
+        this->evaluate_derivatives(this->f1.data());
+
+        for (std::size_t q = 0; q < slots.size(); ++q) {
+            const std::size_t j = slots[q];
+            this->jacobian.set_column(j, this->f0.data(), this->f1.data(), h[q]);
+            x[j] = x_old[q];
+        }
+    }
+
+    this->jacobian.age = 0;
+    ++this->jacobian.evaluations;
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::fused_stage(double dt, bool last, double& new_dt, std::vector<std::size_t>& extinct) {
+    this->update_interactions();
+    this->update_active_edges();
+
+    // nobody reads these species in the sum pass, so they can move on right away
+    for (auto& bucket : this->buckets) {
+        if (bucket->stage_fused) {
+            bucket->stage(*this, dt, last, new_dt, extinct);
+        }
+    }
+
+    for (std::size_t n = 0; n < SUM_SIZE; ++n) {
+        for (auto& bucket : this->buckets) {
+            if (!bucket->stage_fused) {
+                bucket->calculate_sums(*this, n);
+            }
+        }
+    }
+
+    for (auto& bucket : this->buckets) {
+        if (bucket->stage_fused) {
+            continue;
+        }
+        if (last) {
+            bucket->step_last(*this, dt, new_dt, extinct);
+        } else {
+            bucket->step(*this, dt);
+        }
+    }
 }
 
     // perform one timestep of the whole domain
 template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
 double domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::step(double dt) {
 
+    using integrator_t = typename DOM_T::integrator_t;
+
+    const double t0 = this->time;
+
+    if (std::make_pair(this->topology_version, this->species.active_version) != this->fsal_version) {
+        this->species.fsal_ready = false;
+    }
+
+    const bool fsal_ready = this->species.fsal_ready;
+
+    if constexpr (integrator_t::adaptive) {
+        this->x_start = this->species.xs[0];
+        if constexpr (integrator_t::fsal) {
+            this->k_start = this->species.ks[0];
+        }
+        // the active lists of the buckets have to be up to date
+        this->update_interactions();
+        this->update_active_edges();
+        for (auto& bucket : this->buckets) {
+            bucket->save_state(*this);
+        }
+    }
+
+    double new_dt = std::numeric_limits<double>::max();
+
+    while (!this->attempt_step(dt, new_dt)) {
+        // roll back and repeat with the step size of the controller
+        this->time = t0;
+        if constexpr (integrator_t::implicit) {
+            // an older Jacobian may be the reason
+            if (this->jacobian.age > 0) {
+                this->jacobian.age = std::numeric_limits<std::size_t>::max();
+            }
+        }
+        std::copy(this->x_start.begin(), this->x_start.end(), this->species.xs[0].begin());
+        if constexpr (integrator_t::fsal) {
+            std::copy(this->k_start.begin(), this->k_start.end(), this->species.ks[0].begin());
+        }
+        for (auto& bucket : this->buckets) {
+            bucket->restore_state(*this);
+        }
+        this->species.fsal_ready = fsal_ready;
+
+        dt = new_dt;
+        new_dt = std::numeric_limits<double>::max();
+    }
+
+    this->last_dt = dt;
+
+    if constexpr (integrator_t::implicit) {
+        if (this->jacobian.age != std::numeric_limits<std::size_t>::max()) {
+            ++this->jacobian.age;
+        }
+    }
+
+    // If timestep has not been adapted use the old one
+    if (new_dt == std::numeric_limits<double>::max()){
+        return dt; 
+    } else {
+        return new_dt;
+
+    }
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+bool domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::attempt_step(double dt, double& new_dt) {
+
+    using integrator_t = typename DOM_T::integrator_t;
+
     // Increment Time
     this->time += dt;
 
-    double new_dt = std::numeric_limits<double>::max();
+    if constexpr (integrator_t::implicit) {
+        this->update_jacobian();
+    }
 
-    for (size_t i = 0; i < DOM_T::integrator_t::steps; i++)
+    for (size_t i = 0; i < integrator_t::steps; i++)
     {
     
-    
-        /*
-        * In the first step the edges are added to the 'sum' vector of a vertex
-        * This allows to calculate sums over all links e.g. sum all biomass to share carrying capacity
-        * How exactly the edge is added is defined for each species class.
-        */
+        const bool last = i == integrator_t::steps - 1;
 
-        this->calculate_all_sums();
-    
-        if (i == DOM_T::integrator_t::steps - 1) {
+        std::vector<std::size_t> extinct;
+
+        if constexpr (integrator_t::fsal) {
+            if (i == 0 && this->species.fsal_ready) {
+                // first same as last: the first stage needs no sums
+                for (auto& bucket : this->buckets) {
+                    bucket->derive(*this, dt);
+                }
+                integrator_t::stage_update(this->species, this->species.active.data(), 0, dt);
+                continue;
+            }
+        }
+
+        bool engine_sums = false;
+
+        if (this->engine) {
+            // the buckets have to be up to date for the steps
+            this->update_interactions();
+            this->update_active_edges();
+
+            engine_sums = this->engine->calculate_sums(*this);
+        }
+
+        // the stages of implicit integrators are coupled by the Jacobian
+        if (this->fused_stages && !this->gather && !engine_sums && !integrator_t::implicit) {
+
+            this->fused_stage(dt, last, new_dt, extinct);
+
+        } else {
 
+            /*
+            * In the first step the edges are added to the 'sum' vector of a vertex
+            * This allows to calculate sums over all links e.g. sum all biomass to share carrying capacity
+            * How exactly the edge is added is defined for each species class.
+            */
 
-            // perform a step for each organism
-            for (auto v : this->get_vertices() ) {
-                VERTEX_T& vertex2 = this->graph[v];
+            if (!engine_sums) {
+                this->calculate_all_sums();
+            }
+
+            // derivatives of all active organisms, then one sweep over the stage arrays
+            for (auto& bucket : this->buckets) {
+                bucket->derive(*this, dt);
+            }
 
-                vertex2.org->integrator.step(dt);
+            if constexpr (integrator_t::implicit) {
+                integrator_t::stage_update(this->species, this->species.active.data(), int(i), dt, this->jacobian);
+            } else {
+                integrator_t::stage_update(this->species, this->species.active.data(), int(i), dt);
+            }
 
-                vertex2.org->integrator.calc_new_step_size_s(dt, new_dt);
+            if (last) {
+                for (auto& bucket : this->buckets) {
+                    bucket->collect(*this, dt, new_dt, extinct);
+                }
+            }
+        }
+    
+        if (last) {
+
+            // non-finite results are no extinctions, they fail the error norm and the
+            // step is repeated with a smaller one. At min_dt it would be accepted
+            if constexpr (integrator_t::implicit) {
+                extinct.erase(std::remove_if(extinct.begin(), extinct.end(),
+                                             [&](std::size_t j){ return !std::isfinite(this->species.mass(j)); }),
+                              extinct.end());
+
+                if (dt <= this->controller.min_dt) {
+                    for (auto j : this->species.active_slots) {
+                        if (!std::isfinite(this->species.mass(j))) {
+                            throw std::runtime_error("Non-finite biomass at the minimal step size.");
+                        }
+                    }
+                }
+            }
 
-                if (vertex2.get_mass() < this->bm_threshold && vertex2.active){
-                    vertex2.set_mass(0.0);
-                    vertex2.active = false;
-                    vertex2.org->count(-1);
+            // species going extinct do not limit the step
+            const char* norm_slots = this->species.active.data();
+            if (!extinct.empty()) {
+                this->norm_mask.assign(this->species.active.begin(), this->species.active.end());
+                for (auto j : extinct) {
+                    this->norm_mask[j] = false;
                 }
+                norm_slots = this->norm_mask.data();
             }
-            DOM_T::integrator_t::calc_new_step_size(dt, new_dt);
-        } else  {
-            // perform a step for each organism
-            for (auto v : this->get_vertices() ) {
 
-                VERTEX_T& vertex2 = this->graph[v];
-                vertex2.org->integrator.step(dt);
+            if (!integrator_t::calc_new_step_size(this->species, norm_slots, dt, new_dt, this->controller)) {
+                return false;
+            }
 
+            this->fsal_version = {this->topology_version, this->species.active_version};
+
+            // update the active list after the loop over it
+            // inactive slots are not stepped anymore, so clear what they would report
+            for (auto j : extinct) {
+                this->species.mass(j) = 0.0;
+                this->species.extinct_since[j] = this->time;
+                this->slot_org[j]->count(-1);
+                this->species.deactivate(j);
+                this->species.last_dxdt[j] = 0.0;
+                this->species.error[j] = 0.0;
             }
         }
     
     }
 
-    // If timestep has not been adapted use the old one
-    if (new_dt == std::numeric_limits<double>::max()){
-        return dt; 
-    } else {
-        return new_dt;
+    return true;
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+std::size_t domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::compact(double min_age) {
+
+    const std::size_t n = this->slot_vertex.size();
+
+    // find the slots to remove
+    std::vector<char> remove(n, false);
+    std::vector<std::size_t> keep;
+    keep.reserve(n);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!this->species.active[i] && this->time - this->species.extinct_since[i] >= min_age) {
+            remove[i] = true;
+        } else {
+            keep.push_back(i);
+        }
+    }
 
+    if (this->block_layout) {
+        std::stable_sort(keep.begin(), keep.end(),
+                         [&](std::size_t a, std::size_t b){ return this->slot_bucket[a] < this->slot_bucket[b]; });
     }
+
+    if (keep.size() == n && std::is_sorted(keep.begin(), keep.end())) {
+        return 0;
+    }
+
+    // drop edges into removed species from the remaining ones
+    for (auto i : keep) {
+        remove_out_edge_if(this->slot_vertex[i],
+                           [&](const edge_desc_t& e){ return remove[this->graph[target(e, this->graph)].idx]; },
+                           this->graph);
+    }
+
+    // drop the removed species themselves
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!remove[i]) {
+            continue;
+        }
+
+        vertex_desc_t v = this->slot_vertex[i];
+
+        this->psm.erase(this->slot_key[i]);
+
+        clear_out_edges(v, this->graph);
+        remove_vertex(v, this->graph);
+    }
+
+    // renumber the remaining slots
+    this->species.compact(keep);
+    compact_slots(this->slot_vertex, keep);
+    compact_slots(this->slot_org, keep);
+    compact_slots(this->slot_key, keep);
+    compact_slots(this->slot_bucket, keep);
+
+    for (std::size_t i = 0; i < keep.size(); ++i) {
+        this->graph[this->slot_vertex[i]].idx = i;
+        this->slot_org[i]->integrator.set_index(i);
+    }
+
+    this->rebuild_trait_index();
+
+    this->topology_version++;
+
+    return n - keep.size();
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::rebuild_trait_index() {
+
+    for (auto& bucket : this->buckets) {
+        bucket->index_clear();
+    }
+
+    for (std::size_t i = 0; i < this->slot_org.size(); ++i) {
+        this->index_slot(i);
+    }
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::index_slot(std::size_t i) {
+
+    auto& bucket = *this->buckets[this->slot_bucket[i]];
+
+    bucket.index_insert(this->species.trait[i][0], i);
+
+    for (auto& partner : this->buckets) {
+        bucket.add_radius(partner->type, this->slot_org[i]->interaction_radius(this->interaction_tolerance, partner->type));
+    }
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+double domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::get_dead_fraction() const {
+
+    if (this->species.active.empty()) {
+        return 0.0;
+    }
+
+    std::size_t dead = this->species.size() - this->species.count_active();
+
+    return static_cast<double>(dead) / this->species.size();
 }
 
 // Getter & Setter
@@ -474,6 +1833,8 @@ void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_int
 
     this->interaction_tolerance = new_tolerance;
 
+    this->rebuild_trait_index();
+
 }
 
 template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
@@ -483,6 +1844,72 @@ void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_bm_
 
 }
 
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_block_layout(bool b) {
+
+    this->block_layout = b;
+
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_threads(std::size_t n) {
+
+    if (n > 1) {
+        this->pool = std::make_unique<thread_pool>(n);
+    } else {
+        this->pool.reset();
+    }
+
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_gather_sums(bool b) {
+
+    this->gather = b;
+
+    // build the transposed blocks
+    this->active_edges_version.first = std::numeric_limits<std::size_t>::max();
+
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_fused_stages(bool b) {
+
+    this->fused_stages = b;
+
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_sum_engine(std::unique_ptr<engine_t> e) {
+
+    this->engine = std::move(e);
+
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_step_controller(const step_controller& c) {
+
+    // rejected steps have to shrink
+    if (!(c.safety > 0.0 && c.safety < 1.0) || !(c.min_factor > 0.0 && c.min_factor < 1.0) || c.max_factor < 1.0) {
+        throw std::invalid_argument("Step controller needs 0 < safety < 1, 0 < min_factor < 1 and max_factor >= 1.");
+    }
+
+    this->controller = c;
+    this->controller.reset();
+
+}
+
+template <typename DOM_T, typename CURRENCY, typename PSPACE_T, typename VERTEX_T, typename EDGE_T, std::size_t SUM_SIZE>
+void domain_base<DOM_T, CURRENCY, PSPACE_T, VERTEX_T, EDGE_T, SUM_SIZE>::set_jacobian_interval(std::size_t n) {
+
+    if (n < 1) {
+        throw std::invalid_argument("The Jacobian has to be kept for at least 1 step.");
+    }
+
+    this->jacobian_interval = n;
+
+}
+
 
 } // namespace Utopia::Models::MuLAN_MA
 
@@ -0,0 +1,102 @@
+#ifndef UTOPIA_MODELS_INTERACTION_CSR_BASE_HH
+#define UTOPIA_MODELS_INTERACTION_CSR_BASE_HH
+
+#include <cstddef>
+#include <vector>
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Interaction CSR
+     * @details Compressed sparse row snapshot of the interaction graph.
+     *          Edges are stored sorted by source slot, row[i] ... row[i + 1]
+     *          are the edges leaving slot i. The edge order within a row
+     *          is the order of the out edges in the graph.
+     *
+     * @tparam EDGE_CONT Edge container type
+     */
+    template <typename EDGE_CONT>
+    struct interaction_csr {
+
+        using edge_cont = EDGE_CONT;
+
+        /**
+         * @brief Row offsets
+         * @details Size is number of slots + 1
+         *
+         */
+        std::vector<std::size_t> row;
+
+        /**
+         * @brief Source slot of every edge
+         *
+         */
+        std::vector<std::size_t> source;
+
+        /**
+         * @brief Target slot of every edge
+         *
+         */
+        std::vector<std::size_t> target;
+
+        /**
+         * @brief Interaction vector of every edge
+         *
+         */
+        std::vector<EDGE_CONT> weight;
+
+        /**
+         * @brief Number of edges
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t size() const {
+            return this->target.size();
+        }
+
+        /**
+         * @brief Remove all edges
+         *
+         */
+        void clear() {
+            this->row.clear();
+            this->source.clear();
+            this->target.clear();
+            this->weight.clear();
+        }
+
+        /**
+         * @brief Start the next row
+         * @details Call once per slot in ascending order before adding its edges
+         *
+         */
+        void begin_row() {
+            this->row.push_back(this->size());
+        }
+
+        /**
+         * @brief Close the last row
+         *
+         */
+        void finish() {
+            this->row.push_back(this->size());
+        }
+
+        /**
+         * @brief Add an edge to the current row
+         *
+         * @param s Source slot
+         * @param t Target slot
+         * @param w Interaction vector
+         */
+        void push_back(std::size_t s, std::size_t t, const EDGE_CONT& w) {
+            this->source.push_back(s);
+            this->target.push_back(t);
+            this->weight.push_back(w);
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_INTERACTION_CSR_BASE_HH
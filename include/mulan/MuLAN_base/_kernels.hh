@@ -0,0 +1,190 @@
+#ifndef UTOPIA_MODELS_KERNELS_BASE_HH
+#define UTOPIA_MODELS_KERNELS_BASE_HH
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /*
+     * Batch kernels for edge weights and carrying capacities.
+     *
+     * By default the kernels call the exact libm functions. If MULAN_FAST_MATH is
+     * defined, branch free polynomial versions are used instead. Their loops are
+     * vectorized by the compiler for the enabled instruction set (e.g. AVX2 or
+     * AVX-512 with -march=native).
+     *
+     * Error bounds of the fast versions (relative to the libm result):
+     *  - kernel_exp: below 1e-15 for x in [-708, 709.78], 0 below -708
+     *  - kernel_cos: absolute error below 1e-15 for |x| < 1e6, libm beyond
+     */
+
+    /**
+     * @brief Fast exponential
+     * @details Reduction x = k ln2 + r with |r| <= ln2 / 2, degree 12 Taylor
+     *          polynomial for exp(r) and scaling by 2^k through the exponent bits
+     *
+     * @param x
+     * @return double
+     */
+    inline double fast_exp(double x) {
+
+        constexpr double log2e = 1.4426950408889634;
+        constexpr double ln2_hi = 6.93147180369123816490e-01;
+        constexpr double ln2_lo = 1.90821492927058770002e-10;
+
+        // adding 1.5 * 2^52 rounds to an integer kept in the low mantissa bits
+        constexpr double shift = 6755399441055744.0;
+
+        const double xc = std::fmin(std::fmax(x, -708.0), 709.78);
+
+        double kd = xc * log2e + shift;
+        std::uint64_t ki;
+        std::memcpy(&ki, &kd, sizeof(ki));
+        kd -= shift;
+
+        const double r = (xc - kd * ln2_hi) - kd * ln2_lo;
+
+        double p = 1.0 / 479001600.0;
+        p = p * r + 1.0 / 39916800.0;
+        p = p * r + 1.0 / 3628800.0;
+        p = p * r + 1.0 / 362880.0;
+        p = p * r + 1.0 / 40320.0;
+        p = p * r + 1.0 / 5040.0;
+        p = p * r + 1.0 / 720.0;
+        p = p * r + 1.0 / 120.0;
+        p = p * r + 1.0 / 24.0;
+        p = p * r + 1.0 / 6.0;
+        p = p * r + 0.5;
+        p = p * r + 1.0;
+        p = p * r + 1.0;
+
+        // 2^(k - 1), the low 12 bits of ki hold k
+        const std::uint64_t bits = (ki + 1022) << 52;
+        double scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+
+        return x < -708.0 ? 0.0 : p * scale * 2.0;
+    }
+
+    /**
+     * @brief Fast cosine
+     * @details Reduction x = q pi/2 + r with |r| <= pi/4 (three part pi/2),
+     *          Taylor polynomials for sin(r) and cos(r) selected by the quadrant.
+     *          Accurate for |x| < 1e6.
+     *
+     * @param x
+     * @return double
+     */
+    inline double fast_cos(double x) {
+
+        constexpr double two_over_pi = 6.36619772367581382433e-01;
+        constexpr double pio2_1 = 1.57079632673412561417e+00;
+        constexpr double pio2_2 = 6.07710050630396597660e-11;
+        constexpr double pio2_3 = 2.02226624871116645580e-21;
+        constexpr double shift = 6755399441055744.0;
+
+        double qd = x * two_over_pi + shift;
+        std::uint64_t qi;
+        std::memcpy(&qi, &qd, sizeof(qi));
+        qd -= shift;
+
+        const double r = ((x - qd * pio2_1) - qd * pio2_2) - qd * pio2_3;
+        const double r2 = r * r;
+
+        double c = 1.0 / 20922789888000.0;
+        c = c * r2 - 1.0 / 87178291200.0;
+        c = c * r2 + 1.0 / 479001600.0;
+        c = c * r2 - 1.0 / 3628800.0;
+        c = c * r2 + 1.0 / 40320.0;
+        c = c * r2 - 1.0 / 720.0;
+        c = c * r2 + 1.0 / 24.0;
+        c = c * r2 - 0.5;
+        c = c * r2 + 1.0;
+
+        double s = -1.0 / 1307674368000.0;
+        s = s * r2 + 1.0 / 6227020800.0;
+        s = s * r2 - 1.0 / 39916800.0;
+        s = s * r2 + 1.0 / 362880.0;
+        s = s * r2 - 1.0 / 5040.0;
+        s = s * r2 + 1.0 / 120.0;
+        s = s * r2 - 1.0 / 6.0;
+        s = s * r2 + 1.0;
+        s = s * r;
+
+        // cos(x) = cos r, -sin r, -cos r, sin r
+        const std::uint64_t q = qi & 3;
+        const double v = (q & 1) ? s : c;
+
+        return (q == 1 || q == 2) ? -v : v;
+    }
+
+    /**
+     * @brief Exponential of the batch kernels
+     *
+     * @param x
+     * @return double
+     */
+    inline double kernel_exp(double x) {
+#ifdef MULAN_FAST_MATH
+        return fast_exp(x);
+#else
+        return std::exp(x);
+#endif
+    }
+
+    /**
+     * @brief Cosine of the batch kernels
+     * @details Only the batch functions fall back to libm outside the accurate range
+     *
+     * @param x
+     * @return double
+     */
+    inline double kernel_cos(double x) {
+#ifdef MULAN_FAST_MATH
+        return fast_cos(x);
+#else
+        return std::cos(x);
+#endif
+    }
+
+    /**
+     * @brief Gaussian weights
+     * @details out[i] = prefactor * exp(-0.5 * k[i]^2)
+     *
+     * @param k Distances in units of the width
+     * @param n
+     * @param prefactor
+     * @param out
+     */
+    inline void gaussian_batch(const double* k, std::size_t n, double prefactor, double* out) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = prefactor * kernel_exp(-0.5 * k[i] * k[i]);
+        }
+    }
+
+    /**
+     * @brief Cosine of a batch
+     *
+     * @param x
+     * @param n
+     * @param out
+     */
+    inline void cos_batch(const double* x, std::size_t n, double* out) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = kernel_cos(x[i]);
+        }
+#ifdef MULAN_FAST_MATH
+        for (std::size_t i = 0; i < n; ++i) {
+            if (std::abs(x[i]) >= 1.0e6) {
+                out[i] = std::cos(x[i]);
+            }
+        }
+#endif
+    }
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_KERNELS_BASE_HH
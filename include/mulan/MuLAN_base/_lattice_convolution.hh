@@ -0,0 +1,326 @@
+#ifndef UTOPIA_MODELS_LATTICE_CONVOLUTION_BASE_HH
+#define UTOPIA_MODELS_LATTICE_CONVOLUTION_BASE_HH
+
+#ifdef MULAN_USE_FFTW
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <fftw3.h>
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Frees memory allocated by FFTW
+     *
+     * @tparam T
+     */
+    template <typename T>
+    struct fftw_deleter {
+        void operator()(T* p) const {
+            fftw_free(p);
+        }
+    };
+
+    /**
+     * @brief Array with the alignment FFTW plans expect
+     *
+     */
+    template <typename T>
+    using fftw_array = std::unique_ptr<T[], fftw_deleter<T> >;
+
+    /**
+     * @brief Allocate a zero initialized FFTW array
+     *
+     * @tparam T
+     * @param n
+     * @return fftw_array<T>
+     */
+    template <typename T>
+    fftw_array<T> make_fftw_array(std::size_t n) {
+        fftw_array<T> a(static_cast<T*>(fftw_malloc(sizeof(T) * std::max<std::size_t>(n, 1))));
+        std::fill(a.get(), a.get() + n, T{});
+        return a;
+    }
+
+    /**
+     * @brief Gaussian convolution on a lattice
+     * @details Linear convolution of fields on L lattice sites with the kernels
+     *          exp(-0.5 (d h / width)^2), d the distance in sites and h the spacing.
+     *          Uses real FFTs of a zero padded size n >= 2L - 1. Plans are cached by
+     *          size, kernel spectra by width for the current size.
+     *
+     */
+    class lattice_convolution {
+    public:
+
+        using spectrum_t = fftw_array<std::complex<double> >;
+
+    private:
+
+        /**
+         * @brief Lattice spacing
+         *
+         */
+        double spacing;
+
+        /**
+         * @brief Number of lattice sites
+         *
+         */
+        std::size_t length = 0;
+
+        /**
+         * @brief FFT size
+         *
+         */
+        std::size_t n = 0;
+
+        struct plans {
+            fftw_plan forward;
+            fftw_plan backward;
+        };
+
+        /**
+         * @brief Plans of all sizes used so far
+         *
+         */
+        std::map<std::size_t, plans> plan_cache;
+
+        /**
+         * @brief Kernel spectra of the current size
+         *
+         */
+        std::map<double, spectrum_t> kernels;
+
+        fftw_array<double> real_work;
+        spectrum_t complex_work;
+
+        [[nodiscard]] std::size_t n_freq() const {
+            return this->n / 2 + 1;
+        }
+
+        static fftw_complex* as_fftw(std::complex<double>* p) {
+            return reinterpret_cast<fftw_complex*>(p);
+        }
+
+        const plans& plans_of(std::size_t size) {
+
+            auto it = this->plan_cache.find(size);
+
+            if (it == this->plan_cache.end()) {
+                // measuring overwrites the arrays, plan on scratch memory
+                auto in = make_fftw_array<double>(size);
+                auto out = make_fftw_array<std::complex<double> >(size / 2 + 1);
+
+                plans p{};
+                p.forward = fftw_plan_dft_r2c_1d(int(size), in.get(), as_fftw(out.get()), FFTW_MEASURE);
+                p.backward = fftw_plan_dft_c2r_1d(int(size), as_fftw(out.get()), in.get(), FFTW_MEASURE);
+
+                it = this->plan_cache.emplace(size, p).first;
+            }
+
+            return it->second;
+        }
+
+        /**
+         * @brief Spectrum of the kernel with the given width
+         *
+         * @param width
+         * @return const spectrum_t&
+         */
+        const spectrum_t& kernel(double width) {
+
+            auto it = this->kernels.find(width);
+
+            if (it != this->kernels.end()) {
+                return it->second;
+            }
+
+            std::fill(this->real_work.get(), this->real_work.get() + this->n, 0.0);
+
+            // negative distances wrap around to the end
+            for (std::size_t d = 0; d < this->length; ++d) {
+                const double k = double(d) * this->spacing / width;
+                const double v = std::exp(-0.5 * k * k);
+
+                this->real_work[d] = v;
+                if (d > 0) {
+                    this->real_work[this->n - d] = v;
+                }
+            }
+
+            auto s = make_fftw_array<std::complex<double> >(this->n_freq());
+            fftw_execute_dft_r2c(this->plans_of(this->n).forward, this->real_work.get(), as_fftw(s.get()));
+
+            return this->kernels.emplace(width, std::move(s)).first->second;
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new lattice convolution
+         *
+         * @param h Lattice spacing
+         */
+        explicit lattice_convolution(double h = 1.0) : spacing(h) {};
+
+        lattice_convolution(const lattice_convolution&) = delete;
+        lattice_convolution& operator=(const lattice_convolution&) = delete;
+
+        ~lattice_convolution() {
+            for (auto& p : this->plan_cache) {
+                fftw_destroy_plan(p.second.forward);
+                fftw_destroy_plan(p.second.backward);
+            }
+        }
+
+        /**
+         * @brief Lattice spacing
+         *
+         * @return double
+         */
+        [[nodiscard]] double get_spacing() const {
+            return this->spacing;
+        }
+
+        /**
+         * @brief Number of lattice sites
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t size() const {
+            return this->length;
+        }
+
+        /**
+         * @brief Set the number of lattice sites
+         * @details Keeps the kernels if the FFT size does not change
+         *
+         * @param L
+         */
+        void resize(std::size_t L) {
+
+            std::size_t size = 2;
+            while (size + 1 < 2 * L) {
+                size *= 2;
+            }
+
+            this->length = L;
+
+            if (size == this->n) {
+                return;
+            }
+
+            this->n = size;
+            this->kernels.clear();
+            this->plans_of(size);
+
+            this->real_work = make_fftw_array<double>(this->n);
+            this->complex_work = make_fftw_array<std::complex<double> >(this->n_freq());
+        }
+
+        /**
+         * @brief Zero spectrum of the current size
+         *
+         * @return spectrum_t
+         */
+        [[nodiscard]] spectrum_t make_spectrum() const {
+            return make_fftw_array<std::complex<double> >(this->n_freq());
+        }
+
+        /**
+         * @brief Set a spectrum of the current size to zero
+         *
+         * @param s
+         */
+        void clear(spectrum_t& s) const {
+            std::fill(s.get(), s.get() + this->n_freq(), std::complex<double>{});
+        }
+
+        /**
+         * @brief Spectrum of a field
+         *
+         * @param field L values
+         * @param out
+         */
+        void transform(const double* field, spectrum_t& out) {
+
+            std::copy(field, field + this->length, this->real_work.get());
+            std::fill(this->real_work.get() + this->length, this->real_work.get() + this->n, 0.0);
+
+            fftw_execute_dft_r2c(this->plans_of(this->n).forward, this->real_work.get(), as_fftw(out.get()));
+        }
+
+        /**
+         * @brief Add the spectrum of field convolved with a kernel
+         *
+         * @param field L values
+         * @param width Kernel width
+         * @param acc
+         */
+        void accumulate(const double* field, double width, spectrum_t& acc) {
+
+            this->transform(field, this->complex_work);
+
+            const spectrum_t& k = this->kernel(width);
+
+            for (std::size_t i = 0; i < this->n_freq(); ++i) {
+                acc[i] += this->complex_work[i] * k[i];
+            }
+        }
+
+        /**
+         * @brief Field of a spectrum
+         *
+         * @param s Spectrum, left untouched
+         * @param out L values
+         */
+        void inverse(const spectrum_t& s, double* out) {
+
+            // c2r destroys its input
+            const double scale = 1.0 / double(this->n);
+            for (std::size_t i = 0; i < this->n_freq(); ++i) {
+                this->complex_work[i] = s[i] * scale;
+            }
+
+            fftw_execute_dft_c2r(this->plans_of(this->n).backward, as_fftw(this->complex_work.get()), this->real_work.get());
+
+            for (std::size_t l = 0; l < this->length; ++l) {
+                out[l] = this->real_work[l];
+            }
+        }
+
+        /**
+         * @brief Convolve a transformed field with a kernel
+         *
+         * @param s Spectrum of the field
+         * @param width Kernel width
+         * @param out L values
+         */
+        void convolve(const spectrum_t& s, double width, double* out) {
+
+            const spectrum_t& k = this->kernel(width);
+
+            const double scale = 1.0 / double(this->n);
+            for (std::size_t i = 0; i < this->n_freq(); ++i) {
+                this->complex_work[i] = s[i] * k[i] * scale;
+            }
+
+            fftw_execute_dft_c2r(this->plans_of(this->n).backward, as_fftw(this->complex_work.get()), this->real_work.get());
+
+            for (std::size_t l = 0; l < this->length; ++l) {
+                out[l] = this->real_work[l];
+            }
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif // MULAN_USE_FFTW
+
+#endif //UTOPIA_MODELS_LATTICE_CONVOLUTION_BASE_HH
@@ -1,3 +1,5 @@
+#include <cstddef>
+#include <limits>
 #include <boost/exception/detail/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
@@ -31,6 +33,7 @@ namespace Utopia::Models::MuLAN_MA {
 
     public:
         using org_ptr = boost::shared_ptr<ORG_T>;
+        using org_t = ORG_T;
         using edge_cont = typename DOM_T::edge_cont;
 
         using pspace_t = PSPACE_T;
@@ -40,6 +43,45 @@ namespace Utopia::Models::MuLAN_MA {
 
         const static int type_id = 0;
 
+        /**
+         * @brief Partner types with possibly non-zero interaction coefficients
+         * @details Hidden by species classes that interact with few types. Pairs of
+         *          types that interact in neither direction are never evaluated.
+         * 
+         * @param type Type of the other organism
+         * @return true 
+         */
+        static constexpr bool interacts_with(int /*type*/) {
+            return true;
+        }
+
+        /**
+         * @brief Fused sum levels
+         * @details If set, all sum levels of a species are added in one sweep over its
+         *          out edges. Only valid if the sums of the species below level N are
+         *          complete after its own out edges, i.e. no other species writes into them.
+         * 
+         */
+        static constexpr bool fused_sums = false;
+
+        /**
+         * @brief Fused stages
+         * @details If set, the sums, the derivative and the stage update of a species
+         *          are done in one sweep before the other species are summed. Requires
+         *          the fused_sums conditions and that no species reads its value in the
+         *          sum pass, which the domain checks with interacts_with().
+         * 
+         */
+        static constexpr bool fused_stage = false;
+
+        /**
+         * @brief Does dxdt change the organism
+         * @details If set, the domain calls save_state() before every step of an adaptive
+         *          integrator and restore_state() before a rejected step is repeated
+         * 
+         */
+        static constexpr bool stateful_dxdt = false;
+
         /**
          * @brief Count number of species
          * 
@@ -63,11 +105,12 @@ namespace Utopia::Models::MuLAN_MA {
 
         /**
          * @brief Construct a new organism base object
+         * @details The integrator becomes a view on a new slot in the species store of the domain
          * 
          * @param d Domain
          * @param org This Child Object
          */
-        explicit organism_base(DOM_T* d, ORG_T& org) : integrator(org){
+        explicit organism_base(DOM_T* d, ORG_T& org) : integrator(org, d->species){
             this->dom = d;
             
 
@@ -99,26 +142,110 @@ namespace Utopia::Models::MuLAN_MA {
         };
 
 
+        /**
+         * @brief Save the state changed by dxdt
+         * @details Hidden by species classes with stateful_dxdt
+         * 
+         */
+        void save_state() {}
+
+        /**
+         * @brief Restore the state saved by save_state()
+         * 
+         */
+        void restore_state() {}
+
+        /**
+         * @brief Precompute constants derived from the parameters
+         * @details Called by the domain when the species is created and whenever
+         *          its parameters change
+         * 
+         */
+        virtual void update_constants() {};
+
         /**
          * @brief Calculate the interaction of two organisms
          * 
          * @param org2 The second organism
          * @return edge_cont 
          */
-        virtual edge_cont calc_interaction_coeff(const org_ptr org2) const = 0;
+        virtual edge_cont calc_interaction_coeff(const ORG_T& org2) const = 0;
+
+        /**
+         * @brief Calculate the interaction of two organisms
+         * @details Convenience overload for organisms held by the graph
+         * 
+         * @param org2 The second organism
+         * @return edge_cont 
+         */
+        edge_cont calc_interaction_coeff(const org_ptr& org2) const {
+            return this->calc_interaction_coeff(*org2);
+        };
+
+        /**
+         * @brief Calculate the interactions with a batch of organisms
+         * @details Used by the edge construction. Override to evaluate the
+         *          coefficients of all partners in one vectorized loop.
+         *
+         * @param others Partners
+         * @param n Number of partners
+         * @param out Coefficients, out[i] with others[i]
+         */
+        virtual void calc_interaction_coeffs(const ORG_T* const* others, std::size_t n, edge_cont* out) const {
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = this->calc_interaction_coeff(*others[i]);
+            }
+        };
+
+        /**
+         * @brief Interaction radius in trait space
+         * @details Bound on |trait[0] - org2.trait[0]| for all org2 of the given type where
+         *          calc_interaction_coeff(org2) can exceed the tolerance. Negative if no
+         *          organism of that type can. Unbounded by default.
+         * 
+         * @param tolerance Interaction tolerance of the domain
+         * @param type Type of org2
+         * @return double 
+         */
+        [[nodiscard]] virtual double interaction_radius(double /*tolerance*/, int /*type*/) const {
+            return std::numeric_limits<double>::infinity();
+        };
 
         /**
          * @brief Add the interaction to the sum vector
+         * @details Hot path: takes the partner by reference, ownership stays with the graph
          * 
          * @param val 
          * @param organism_2 
          */
 
         template<int N>
-        void add_edge_cont(const edge_cont& val, org_ptr organism_2) {
+        void add_edge_cont(const edge_cont& val, ORG_T& organism_2) {
             static_cast<ORG_T&>(*this).template add_edge_cont<N>(val, organism_2);
         };
 
+        /**
+         * @brief Add the half of the interaction that goes into the own sum vector
+         * 
+         * @param val 
+         * @param organism_2 
+         */
+        template<int N>
+        void add_own_cont(const edge_cont& val, ORG_T& organism_2) {
+            static_cast<ORG_T&>(*this).template add_own_cont<N>(val, organism_2);
+        };
+
+        /**
+         * @brief Add the half of the interaction that goes into the sum vector of organism_2
+         * 
+         * @param val 
+         * @param organism_2 
+         */
+        template<int N>
+        void add_partner_cont(const edge_cont& val, ORG_T& organism_2) {
+            static_cast<ORG_T&>(*this).template add_partner_cont<N>(val, organism_2);
+        };
+
         /**
          * @brief Change count for organism
          * 
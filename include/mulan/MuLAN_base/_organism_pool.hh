@@ -0,0 +1,185 @@
+#ifndef UTOPIA_MODELS_ORGANISM_POOL_BASE_HH
+#define UTOPIA_MODELS_ORGANISM_POOL_BASE_HH
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Organism Arena
+     * @details Hands out blocks of one fixed size from contiguous chunks.
+     *          Released blocks go to a free list and are reused first, so
+     *          objects of one type stay close together in memory.
+     *          The block size is fixed by the first allocation, requests of
+     *          other sizes are passed on to the global operator new.
+     *
+     */
+    class organism_arena {
+    private:
+        /**
+         * @brief Size of a block in bytes
+         *
+         */
+        std::size_t block_size = 0;
+
+        /**
+         * @brief Number of blocks per chunk
+         *
+         */
+        std::size_t blocks_per_chunk;
+
+        /**
+         * @brief Blocks handed out from the last chunk
+         *
+         */
+        std::size_t used_in_chunk = 0;
+
+        /**
+         * @brief Chunks of memory
+         *
+         */
+        std::vector<std::unique_ptr<std::byte[]> > chunks;
+
+        /**
+         * @brief Released blocks
+         *
+         */
+        std::vector<void*> free_list;
+
+    public:
+
+        /**
+         * @brief Construct a new organism arena
+         *
+         * @param blocks_per_chunk Number of blocks allocated at once
+         */
+        explicit organism_arena(std::size_t blocks_per_chunk = 64) : blocks_per_chunk(blocks_per_chunk) {};
+
+        organism_arena(const organism_arena&) = delete;
+        organism_arena& operator=(const organism_arena&) = delete;
+
+        /**
+         * @brief Allocate a block
+         *
+         * @param bytes Size of the block
+         * @return void*
+         */
+        void* allocate(std::size_t bytes) {
+
+            if (this->block_size == 0) {
+                // round up to keep every block aligned
+                constexpr std::size_t align = alignof(std::max_align_t);
+                this->block_size = (bytes + align - 1) / align * align;
+                this->used_in_chunk = this->blocks_per_chunk;
+            }
+
+            if (bytes > this->block_size) {
+                return ::operator new(bytes);
+            }
+
+            if (!this->free_list.empty()) {
+                void* p = this->free_list.back();
+                this->free_list.pop_back();
+                return p;
+            }
+
+            if (this->used_in_chunk == this->blocks_per_chunk) {
+                this->chunks.emplace_back(new std::byte[this->block_size * this->blocks_per_chunk]);
+                this->used_in_chunk = 0;
+            }
+
+            return this->chunks.back().get() + this->block_size * this->used_in_chunk++;
+        }
+
+        /**
+         * @brief Release a block
+         *
+         * @param p
+         * @param bytes Size the block was allocated with
+         */
+        void deallocate(void* p, std::size_t bytes) {
+
+            if (bytes > this->block_size) {
+                ::operator delete(p);
+                return;
+            }
+
+            this->free_list.push_back(p);
+        }
+
+        /**
+         * @brief Number of blocks in use
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t size() const {
+            return this->capacity() - this->free_list.size()
+                    - (this->chunks.empty() ? 0 : this->blocks_per_chunk - this->used_in_chunk);
+        }
+
+        /**
+         * @brief Number of blocks allocated
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t capacity() const {
+            return this->chunks.size() * this->blocks_per_chunk;
+        }
+
+    };
+
+    /**
+     * @brief Pool Allocator
+     * @details Standard allocator drawing memory from an organism_arena.
+     *          The allocator shares ownership of the arena, so the arena
+     *          lives as long as any object allocated from it.
+     *
+     * @tparam T
+     */
+    template <typename T>
+    struct pool_allocator {
+
+        using value_type = T;
+
+        /**
+         * @brief The arena
+         *
+         */
+        std::shared_ptr<organism_arena> arena;
+
+        explicit pool_allocator(std::shared_ptr<organism_arena> arena) : arena(std::move(arena)) {};
+
+        template <typename U>
+        pool_allocator(const pool_allocator<U>& other) : arena(other.arena) {};
+
+        template <typename U>
+        struct rebind {
+            using other = pool_allocator<U>;
+        };
+
+        T* allocate(std::size_t n) {
+            return static_cast<T*>(this->arena->allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, std::size_t n) {
+            this->arena->deallocate(p, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const pool_allocator<U>& other) const {
+            return this->arena == other.arena;
+        }
+
+        template <typename U>
+        bool operator!=(const pool_allocator<U>& other) const {
+            return this->arena != other.arena;
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_ORGANISM_POOL_BASE_HH
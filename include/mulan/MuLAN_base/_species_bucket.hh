@@ -0,0 +1,556 @@
+#ifndef UTOPIA_MODELS_SPECIES_BUCKET_BASE_HH
+#define UTOPIA_MODELS_SPECIES_BUCKET_BASE_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <set>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "_interaction_csr.hh"
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Species Bucket Interface
+     * @details All species of one concrete type. The domain calls the kernels
+     *          once per bucket, the loops inside run on the concrete type.
+     *
+     * @tparam DOM_BASE Domain base type
+     */
+    template <typename DOM_BASE>
+    class species_bucket_base {
+    public:
+
+        /**
+         * @brief Active slots of this type
+         * @details Sorted ascending
+         *
+         */
+        std::vector<std::size_t> active_slots;
+
+        /**
+         * @brief Interaction blocks
+         * @details Active edges leaving species of this type, one block per target bucket.
+         *          Row r of every block belongs to active_slots[r], weights are stored contiguously.
+         *
+         */
+        std::vector<typename DOM_BASE::csr_t> blocks;
+
+        /**
+         * @brief Transposed interaction blocks
+         * @details Active edges entering species of this type, one block per source bucket.
+         *          Row r of every block belongs to active_slots[r], sorted by source slot.
+         *          Only built for gathered sums.
+         *
+         */
+        std::vector<typename DOM_BASE::csr_t> in_blocks;
+
+        /**
+         * @brief Trait index
+         * @details All slots of this type ordered by trait[0]
+         *
+         */
+        std::set<std::pair<double, std::size_t> > trait_index;
+
+        /**
+         * @brief Type ID of the species in this bucket
+         *
+         */
+        int type = 0;
+
+        /**
+         * @brief Largest interaction radius of the species in this bucket
+         * @details max_radius[t] bounds the radius towards organisms of type t
+         *
+         */
+        std::vector<double> max_radius;
+
+        virtual ~species_bucket_base() = default;
+
+        /**
+         * @brief Add a slot to the trait index
+         *
+         * @param trait trait[0] of the species
+         * @param i Slot
+         */
+        void index_insert(double trait, std::size_t i) {
+            this->trait_index.emplace(trait, i);
+        }
+
+        /**
+         * @brief Remove a slot from the trait index
+         *
+         * @param trait trait[0] the slot was indexed with
+         * @param i Slot
+         */
+        void index_erase(double trait, std::size_t i) {
+            this->trait_index.erase({trait, i});
+        }
+
+        /**
+         * @brief Include an interaction radius towards type t
+         *
+         * @param t Type of the partner
+         * @param radius
+         */
+        void add_radius(int t, double radius) {
+            if (this->max_radius.size() <= static_cast<std::size_t>(t)) {
+                this->max_radius.resize(t + 1, -std::numeric_limits<double>::infinity());
+            }
+            this->max_radius[t] = std::max(this->max_radius[t], radius);
+        }
+
+        /**
+         * @brief Largest interaction radius towards type t
+         * @details Negative if no species of this bucket interacts with type t
+         *
+         * @param t
+         * @return double
+         */
+        [[nodiscard]] double get_max_radius(int t) const {
+            if (static_cast<std::size_t>(t) < this->max_radius.size()) {
+                return this->max_radius[t];
+            }
+            return -std::numeric_limits<double>::infinity();
+        }
+
+        /**
+         * @brief Slots with trait[0] in [lo, hi]
+         *
+         * @param lo
+         * @param hi
+         * @param out Slots are appended
+         */
+        void index_query(double lo, double hi, std::vector<std::size_t>& out) const {
+            auto end = this->trait_index.upper_bound({hi, std::numeric_limits<std::size_t>::max()});
+            for (auto it = this->trait_index.lower_bound({lo, 0}); it != end; ++it) {
+                out.push_back(it->second);
+            }
+        }
+
+        /**
+         * @brief Entries of the trait index with trait[0] in [lo, hi]
+         *
+         * @param lo
+         * @param hi
+         * @param out (trait[0], slot) pairs are appended in trait order
+         */
+        void index_range(double lo, double hi, std::vector<std::pair<double, std::size_t> >& out) const {
+            auto end = this->trait_index.upper_bound({hi, std::numeric_limits<std::size_t>::max()});
+            out.insert(out.end(), this->trait_index.lower_bound({lo, 0}), end);
+        }
+
+        /**
+         * @brief Clear the trait index
+         *
+         */
+        void index_clear() {
+            this->trait_index.clear();
+            this->max_radius.clear();
+        }
+
+        /**
+         * @brief Can species of this bucket interact with type t
+         * @details Declared at compile time by the species class
+         *
+         * @param t Type of the partner
+         * @return bool
+         */
+        [[nodiscard]] virtual bool interacts_with(int t) const = 0;
+
+        /**
+         * @brief Interaction coefficients of a pair in both directions
+         * @details Only the directions set in mask are evaluated, the others are left untouched
+         *
+         * @param ref Species of this bucket
+         * @param other Partner
+         * @param mask 1: ref with other, 2: other with ref
+         * @param z1 Coefficient of ref with other
+         * @param z2 Coefficient of other with ref
+         */
+        virtual void coeffs(const typename DOM_BASE::org_t& ref, const typename DOM_BASE::org_t& other, unsigned char mask,
+                            typename DOM_BASE::edge_cont& z1, typename DOM_BASE::edge_cont& z2) const = 0;
+
+        /**
+         * @brief Interaction coefficients of a species of this bucket with a batch of partners
+         *
+         * @param ref Species of this bucket
+         * @param others Partners
+         * @param n Number of partners
+         * @param out Coefficients of ref with others[i]
+         */
+        virtual void coeffs_batch(const typename DOM_BASE::org_t& ref, const typename DOM_BASE::org_t* const* others,
+                                  std::size_t n, typename DOM_BASE::edge_cont* out) const = 0;
+
+        /**
+         * @brief Perform a substep for all active species
+         *
+         * @param dom
+         * @param dt
+         */
+        virtual void step(DOM_BASE& dom, double dt) = 0;
+
+        /**
+         * @brief Perform the last substep for all active species
+         * @details Also collects the step size estimate and the species that fell below the threshold
+         *
+         * @param dom
+         * @param dt
+         * @param new_dt
+         * @param extinct Slots below the biomass threshold
+         */
+        virtual void step_last(DOM_BASE& dom, double dt, double& new_dt, std::vector<std::size_t>& extinct) = 0;
+
+        /**
+         * @brief Derivative of the current stage for all active species
+         * @details Batched stepping, the domain updates the stage values of all
+         *          species at once afterwards
+         *
+         * @param dom
+         * @param dt
+         */
+        virtual void derive(DOM_BASE& dom, double dt) = 0;
+
+        /**
+         * @brief Derivatives of all active species at their current values
+         * @details Used for the Jacobian of implicit integrators, needs the sums
+         *          and does not touch the stage arrays
+         *
+         * @param dom
+         * @param out Derivative of every slot, only active slots are written
+         */
+        virtual void evaluate(DOM_BASE& dom, typename DOM_BASE::currency* out) = 0;
+
+        /**
+         * @brief Collect the step size estimate and the species that fell below the threshold
+         * @details Batched stepping, after the last stage update
+         *
+         * @param dom
+         * @param dt
+         * @param new_dt
+         * @param extinct Slots below the biomass threshold
+         */
+        virtual void collect(DOM_BASE& dom, double dt, double& new_dt, std::vector<std::size_t>& extinct) = 0;
+
+        /**
+         * @brief Species of this bucket run fused stages
+         * @details Set by the domain if the class allows it and no type has edges into it
+         *
+         */
+        bool stage_fused = false;
+
+        /**
+         * @brief Does the species class allow fused stages
+         *
+         * @return bool
+         */
+        [[nodiscard]] virtual bool can_fuse_stage() const = 0;
+
+        /**
+         * @brief Save the state of all active species changed by their derivatives
+         * @details Nothing to do for species classes without stateful_dxdt
+         *
+         * @param dom
+         */
+        virtual void save_state(DOM_BASE& dom) = 0;
+
+        /**
+         * @brief Restore the state saved by save_state()
+         *
+         * @param dom
+         */
+        virtual void restore_state(DOM_BASE& dom) = 0;
+
+        /**
+         * @brief Sums, derivative and stage update for all active species in one sweep
+         * @details Partner halves of the edges are still written to the partners
+         *
+         * @param dom
+         * @param dt
+         * @param last Last substep, also collects the step size estimate and extinct species
+         * @param new_dt
+         * @param extinct
+         */
+        virtual void stage(DOM_BASE& dom, double dt, bool last, double& new_dt, std::vector<std::size_t>& extinct) = 0;
+
+        /**
+         * @brief Add the active edges to sum level n
+         * @details Species classes with fused_sums add all levels for n == 0
+         *
+         * @param dom
+         * @param n
+         */
+        virtual void calculate_sums(DOM_BASE& dom, std::size_t n) = 0;
+
+        /**
+         * @brief Gather sum level n for the active species in rows [begin, end)
+         * @details Every species collects the own part of its out edges and the partner
+         *          part of its in edges. Only the sums of these rows are written, so
+         *          disjoint row ranges can run concurrently.
+         *
+         * @param dom
+         * @param n
+         * @param begin
+         * @param end
+         */
+        virtual void gather_sums(DOM_BASE& dom, std::size_t n, std::size_t begin, std::size_t end) = 0;
+
+        /**
+         * @brief Clear the active lists
+         *
+         */
+        void clear() {
+            this->active_slots.clear();
+            for (auto& block : this->blocks) {
+                block.clear();
+            }
+            for (auto& block : this->in_blocks) {
+                block.clear();
+            }
+        }
+
+    };
+
+    /**
+     * @brief Species Bucket
+     * @details Kernels for species of type SPECIES. If SPECIES is final the calls
+     *          to dxdt and the edge kernels are resolved statically and can be inlined.
+     *
+     * @tparam DOM_BASE Domain base type
+     * @tparam SPECIES Concrete species type
+     */
+    template <typename DOM_BASE, typename SPECIES>
+    class species_bucket final : public species_bucket_base<DOM_BASE> {
+    private:
+
+        /**
+         * @brief Sum level N
+         *
+         * @tparam N
+         * @param dom
+         */
+        template <std::size_t N>
+        void sums(DOM_BASE& dom) {
+            for (const auto& block : this->blocks) {
+                for (std::size_t r = 0; r < this->active_slots.size(); ++r) {
+                    SPECIES& org = static_cast<SPECIES&>(*dom.slot_org[this->active_slots[r]]);
+
+                    for (std::size_t k = block.row[r]; k < block.row[r + 1]; ++k) {
+                        org.template add_edge_cont<N, SPECIES>(block.weight[k], *dom.slot_org[block.target[k]]);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief All sum levels of the species in row r
+         * @details The edges of a species are swept once per level while they are in cache
+         *
+         * @tparam N
+         * @param dom
+         * @param org Species in row r
+         * @param r
+         */
+        template <std::size_t... N>
+        void fused_row(DOM_BASE& dom, SPECIES& org, std::size_t r, std::index_sequence<N...>) {
+
+            auto level = [&](auto n) {
+                for (const auto& block : this->blocks) {
+                    for (std::size_t k = block.row[r]; k < block.row[r + 1]; ++k) {
+                        org.template add_edge_cont<decltype(n)::value, SPECIES>(block.weight[k], *dom.slot_org[block.target[k]]);
+                    }
+                }
+            };
+
+            (level(std::integral_constant<std::size_t, N>{}), ...);
+        }
+
+        /**
+         * @brief All sum levels, one species at a time
+         *
+         * @param dom
+         */
+        void fused(DOM_BASE& dom) {
+            for (std::size_t r = 0; r < this->active_slots.size(); ++r) {
+                SPECIES& org = static_cast<SPECIES&>(*dom.slot_org[this->active_slots[r]]);
+
+                this->fused_row(dom, org, r, std::make_index_sequence<DOM_BASE::sum_size>{});
+            }
+        }
+
+        /**
+         * @brief Gather sum level N for rows [begin, end)
+         *
+         * @tparam N
+         * @param dom
+         * @param begin
+         * @param end
+         */
+        template <std::size_t N>
+        void gather(DOM_BASE& dom, std::size_t begin, std::size_t end) {
+            for (std::size_t r = begin; r < end; ++r) {
+                SPECIES& org = static_cast<SPECIES&>(*dom.slot_org[this->active_slots[r]]);
+
+                for (const auto& block : this->blocks) {
+                    for (std::size_t k = block.row[r]; k < block.row[r + 1]; ++k) {
+                        org.template add_own_cont<N, SPECIES>(block.weight[k], *dom.slot_org[block.target[k]]);
+                    }
+                }
+
+                for (const auto& block : this->in_blocks) {
+                    for (std::size_t k = block.row[r]; k < block.row[r + 1]; ++k) {
+                        dom.slot_org[block.source[k]]->template add_partner_cont<N>(block.weight[k], org);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Select sum level n at compile time
+         *
+         * @tparam N
+         * @tparam F
+         * @param n
+         * @param f Called with std::integral_constant<std::size_t, n>
+         */
+        template <std::size_t N, typename F>
+        static void level_iter(std::size_t n, F&& f) {
+            if constexpr ( N < DOM_BASE::sum_size ) {
+                if (n == N) {
+                    f(std::integral_constant<std::size_t, N>{});
+                } else {
+                    level_iter<N + 1>(n, f);
+                }
+            }
+        }
+
+    public:
+
+        [[nodiscard]] bool interacts_with(int t) const override {
+            return SPECIES::interacts_with(t);
+        }
+
+        void coeffs(const typename DOM_BASE::org_t& ref, const typename DOM_BASE::org_t& other, unsigned char mask,
+                    typename DOM_BASE::edge_cont& z1, typename DOM_BASE::edge_cont& z2) const override {
+
+            const SPECIES& self = static_cast<const SPECIES&>(ref);
+
+            if (mask & 1) {
+                z1 = self.calc_interaction_coeff(other);
+            }
+            if (mask & 2) {
+                z2 = other.calc_interaction_coeff(self);
+            }
+        }
+
+        void coeffs_batch(const typename DOM_BASE::org_t& ref, const typename DOM_BASE::org_t* const* others,
+                          std::size_t n, typename DOM_BASE::edge_cont* out) const override {
+            static_cast<const SPECIES&>(ref).calc_interaction_coeffs(others, n, out);
+        }
+
+        void step(DOM_BASE& dom, double dt) override {
+            for (auto j : this->active_slots) {
+                static_cast<SPECIES*>(dom.slot_org[j])->integrator.template step<SPECIES>(dt);
+            }
+        }
+
+        void step_last(DOM_BASE& dom, double dt, double& new_dt, std::vector<std::size_t>& extinct) override {
+            for (auto j : this->active_slots) {
+                SPECIES* org = static_cast<SPECIES*>(dom.slot_org[j]);
+
+                org->integrator.template step<SPECIES>(dt);
+
+                org->integrator.calc_new_step_size_s(dt, new_dt);
+
+                if (dom.species.mass(j) < dom.bm_threshold) {
+                    extinct.push_back(j);
+                }
+            }
+        }
+
+        void derive(DOM_BASE& dom, double dt) override {
+            for (auto j : this->active_slots) {
+                static_cast<SPECIES*>(dom.slot_org[j])->integrator.template derive<SPECIES>(dt);
+            }
+        }
+
+        void evaluate(DOM_BASE& dom, typename DOM_BASE::currency* out) override {
+            for (auto j : this->active_slots) {
+                auto& org = *static_cast<SPECIES*>(dom.slot_org[j]);
+                out[j] = org.dxdt(org.integrator.get_value(), 0.0);
+            }
+        }
+
+        void collect(DOM_BASE& dom, double dt, double& new_dt, std::vector<std::size_t>& extinct) override {
+            for (auto j : this->active_slots) {
+                static_cast<SPECIES*>(dom.slot_org[j])->integrator.calc_new_step_size_s(dt, new_dt);
+
+                if (dom.species.mass(j) < dom.bm_threshold) {
+                    extinct.push_back(j);
+                }
+            }
+        }
+
+        [[nodiscard]] bool can_fuse_stage() const override {
+            return SPECIES::fused_stage;
+        }
+
+        void save_state(DOM_BASE& dom) override {
+            if constexpr (SPECIES::stateful_dxdt) {
+                for (auto j : this->active_slots) {
+                    static_cast<SPECIES*>(dom.slot_org[j])->save_state();
+                }
+            }
+        }
+
+        void restore_state(DOM_BASE& dom) override {
+            if constexpr (SPECIES::stateful_dxdt) {
+                for (auto j : this->active_slots) {
+                    static_cast<SPECIES*>(dom.slot_org[j])->restore_state();
+                }
+            }
+        }
+
+        void stage(DOM_BASE& dom, double dt, bool last, double& new_dt, std::vector<std::size_t>& extinct) override {
+            for (std::size_t r = 0; r < this->active_slots.size(); ++r) {
+                const std::size_t j = this->active_slots[r];
+                SPECIES& org = static_cast<SPECIES&>(*dom.slot_org[j]);
+
+                // the sums are consumed right after they are written
+                this->fused_row(dom, org, r, std::make_index_sequence<DOM_BASE::sum_size>{});
+
+                org.integrator.template step<SPECIES>(dt);
+
+                if (last) {
+                    org.integrator.calc_new_step_size_s(dt, new_dt);
+
+                    if (dom.species.mass(j) < dom.bm_threshold) {
+                        extinct.push_back(j);
+                    }
+                }
+            }
+        }
+
+        void calculate_sums(DOM_BASE& dom, std::size_t n) override {
+            if constexpr ( SPECIES::fused_sums ) {
+                // all levels with the first one
+                if (n == 0) {
+                    this->fused(dom);
+                }
+            } else {
+                level_iter<0>(n, [&](auto level){ this->template sums<decltype(level)::value>(dom); });
+            }
+        }
+
+        void gather_sums(DOM_BASE& dom, std::size_t n, std::size_t begin, std::size_t end) override {
+            level_iter<0>(n, [&](auto level){ this->template gather<decltype(level)::value>(dom, begin, end); });
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_SPECIES_BUCKET_BASE_HH
@@ -0,0 +1,170 @@
+#include <algorithm>
+
+#include "integrators/integrator_store.hh"
+
+#ifndef UTOPIA_MODELS_SPECIES_STORE_BASE_HH
+#define UTOPIA_MODELS_SPECIES_STORE_BASE_HH
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Species Store
+     * @details Structure-of-arrays store of all species of a domain.
+     *          Extends the integrator store by the per species data the
+     *          domain needs in its loops. Species are addressed by their slot index.
+     *
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam TRAIT_T Trait Type
+     */
+    template <typename CURRENCY, typename TRAIT_T>
+    struct species_store : integrator_store<CURRENCY> {
+
+        using currency = CURRENCY;
+        using trait_t = TRAIT_T;
+
+        /**
+         * @brief Traits
+         *
+         */
+        std::vector<TRAIT_T> trait;
+
+        /**
+         * @brief Type/Layer IDs
+         *
+         */
+        std::vector<int> type;
+
+        /**
+         * @brief Active flags
+         * @details char instead of bool to keep the flags addressable
+         *
+         */
+        std::vector<char> active;
+
+        /**
+         * @brief Time of extinction
+         * @details Only meaningful for inactive slots
+         *
+         */
+        std::vector<double> extinct_since;
+
+        /**
+         * @brief Active slots
+         * @details Dense list of the active slots, sorted ascending.
+         *          Only change via activate() and deactivate().
+         *
+         */
+        std::vector<std::size_t> active_slots;
+
+        /**
+         * @brief Active version
+         * @details Incremented whenever the set of active slots changes
+         *
+         */
+        std::size_t active_version = 0;
+
+        /**
+         * @brief Append a new slot
+         *
+         * @return std::size_t Index of the new slot
+         */
+        std::size_t emplace_back() {
+            this->trait.emplace_back();
+            this->type.push_back(0);
+            this->active.push_back(true);
+            this->extinct_since.push_back(0.0);
+
+            std::size_t i = integrator_store<CURRENCY>::emplace_back();
+
+            // new slots are the largest index, the list stays sorted
+            this->active_slots.push_back(i);
+            this->active_version++;
+
+            return i;
+        }
+
+        /**
+         * @brief Mark slot i active
+         *
+         * @param i
+         */
+        void activate(std::size_t i) {
+            if (this->active[i]) {
+                return;
+            }
+            this->active[i] = true;
+            this->active_slots.insert(std::lower_bound(this->active_slots.begin(), this->active_slots.end(), i), i);
+            this->active_version++;
+        }
+
+        /**
+         * @brief Mark slot i inactive
+         *
+         * @param i
+         */
+        void deactivate(std::size_t i) {
+            if (!this->active[i]) {
+                return;
+            }
+            this->active[i] = false;
+            this->active_slots.erase(std::lower_bound(this->active_slots.begin(), this->active_slots.end(), i));
+            this->active_version++;
+        }
+
+        /**
+         * @brief Number of active slots
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t count_active() const {
+            return this->active_slots.size();
+        }
+
+        /**
+         * @brief Keep only the given slots
+         * @details Slot keep[n] becomes slot n
+         *
+         * @param keep Slots to keep
+         */
+        void compact(const std::vector<std::size_t>& keep) {
+            integrator_store<CURRENCY>::compact(keep);
+            compact_slots(this->trait, keep);
+            compact_slots(this->type, keep);
+            compact_slots(this->active, keep);
+            compact_slots(this->extinct_since, keep);
+
+            this->active_slots.clear();
+            for (std::size_t i = 0; i < this->active.size(); ++i) {
+                if (this->active[i]) {
+                    this->active_slots.push_back(i);
+                }
+            }
+            this->active_version++;
+        }
+
+        /**
+         * @brief Biomass of slot i
+         * @details Only valid between two full integration steps
+         *
+         * @param i
+         * @return currency&
+         */
+        currency& mass(std::size_t i) {
+            return this->xs[0][i];
+        }
+
+        /**
+         * @brief Biomass of slot i
+         *
+         * @param i
+         * @return const currency&
+         */
+        const currency& mass(std::size_t i) const {
+            return this->xs[0][i];
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_SPECIES_STORE_BASE_HH
@@ -0,0 +1,35 @@
+#ifndef UTOPIA_MODELS_SUM_ENGINE_BASE_HH
+#define UTOPIA_MODELS_SUM_ENGINE_BASE_HH
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Sum Engine Interface
+     * @details Alternative to the sums over the edges, e.g. for communities with a
+     *          structure that allows a cheaper evaluation. The domain asks the engine
+     *          in every stage and falls back to the edges if it does not apply.
+     *
+     * @tparam DOM_BASE Domain base type
+     */
+    template <typename DOM_BASE>
+    class sum_engine {
+    public:
+
+        using domain_t = DOM_BASE;
+
+        virtual ~sum_engine() = default;
+
+        /**
+         * @brief Add all sums of the current stage
+         * @details Must not change any sum if it returns false
+         *
+         * @param dom
+         * @return bool False if the engine does not apply to the current community
+         */
+        virtual bool calculate_sums(DOM_BASE& dom) = 0;
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_SUM_ENGINE_BASE_HH
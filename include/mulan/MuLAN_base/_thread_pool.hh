@@ -0,0 +1,188 @@
+#ifndef UTOPIA_MODELS_THREAD_POOL_BASE_HH
+#define UTOPIA_MODELS_THREAD_POOL_BASE_HH
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Thread Pool
+     * @details Fixed set of worker threads for data parallel loops. The calling
+     *          thread takes part in the work. Ranges are split statically into
+     *          contiguous chunks, so every index is always handled by the same
+     *          chunk and results written by index are reproducible.
+     *
+     */
+    class thread_pool {
+    private:
+
+        /**
+         * @brief Worker threads
+         *
+         */
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable start;
+        std::condition_variable done;
+
+        /**
+         * @brief Current job, called with the chunk number
+         *
+         */
+        std::function<void(std::size_t)> job;
+
+        /**
+         * @brief Incremented for every job
+         *
+         */
+        std::size_t generation = 0;
+
+        /**
+         * @brief Workers still busy with the current job
+         *
+         */
+        std::size_t busy = 0;
+
+        /**
+         * @brief First exception thrown by a chunk of the current job
+         *
+         */
+        std::exception_ptr error;
+
+        bool stop = false;
+
+        /**
+         * @brief Worker loop
+         *
+         * @param chunk Chunk handled by this worker
+         */
+        void work(std::size_t chunk) {
+
+            std::size_t seen = 0;
+
+            while (true) {
+                std::function<void(std::size_t)> f;
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->start.wait(lock, [&]{ return this->stop || this->generation != seen; });
+
+                    if (this->stop) {
+                        return;
+                    }
+
+                    seen = this->generation;
+                    f = this->job;
+                }
+
+                f(chunk);
+
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    if (--this->busy == 0) {
+                        this->done.notify_one();
+                    }
+                }
+            }
+        }
+
+    public:
+
+        /**
+         * @brief Construct a new thread pool
+         *
+         * @param n Number of threads including the calling one
+         */
+        explicit thread_pool(std::size_t n) {
+            for (std::size_t i = 1; i < n; ++i) {
+                this->workers.emplace_back(&thread_pool::work, this, i);
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stop = true;
+            }
+            this->start.notify_all();
+
+            for (auto& w : this->workers) {
+                w.join();
+            }
+        }
+
+        /**
+         * @brief Number of threads including the calling one
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t size() const {
+            return this->workers.size() + 1;
+        }
+
+        /**
+         * @brief Call f(begin, end) on contiguous chunks of [0, n) in parallel
+         * @details Returns when all chunks are done. If chunks throw, the first
+         *          exception is rethrown on the calling thread after all are done
+         *
+         * @tparam F
+         * @param n
+         * @param f
+         */
+        template <typename F>
+        void parallel_for(std::size_t n, F&& f) {
+
+            const std::size_t chunks = this->size();
+
+            auto run = [&](std::size_t c) {
+                const std::size_t begin = n * c / chunks;
+                const std::size_t end = n * (c + 1) / chunks;
+                if (begin < end) {
+                    try {
+                        f(begin, end);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        if (!this->error) {
+                            this->error = std::current_exception();
+                        }
+                    }
+                }
+            };
+
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->job = run;
+                this->busy = this->workers.size();
+                this->generation++;
+            }
+            this->start.notify_all();
+
+            run(0);
+
+            std::exception_ptr e;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->done.wait(lock, [&]{ return this->busy == 0; });
+                std::swap(e, this->error);
+            }
+
+            if (e) {
+                std::rethrow_exception(e);
+            }
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_THREAD_POOL_BASE_HH
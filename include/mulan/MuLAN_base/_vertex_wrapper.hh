@@ -5,11 +5,14 @@
 #ifndef UTOPIA_VERTEX_WRAPPER_BASE_HH
 #define UTOPIA_VERTEX_WRAPPER_BASE_HH
 
+#include "_species_store.hh"
+
 namespace Utopia::Models::MuLAN_MA{
 
     /**
      * @brief Vertex_wrapper is the object stored on the graph
-     * @details Holds a pointer to an organism of type ORG_T
+     * @details Holds a pointer to an organism of type ORG_T and is a view
+     *          on the slot of the organism in the species store of the domain
      *
      * @tparam ORG_T
      */
@@ -20,6 +23,10 @@ namespace Utopia::Models::MuLAN_MA{
 
         using trait_t = typename pspace_t::trait_t;
 
+        using org_t = ORG_T;
+
+        using store_t = species_store<typename ORG_T::currency, trait_t>;
+
         /**
          * @brief Construct a new vertex wrapper base object
          *
@@ -46,10 +53,16 @@ namespace Utopia::Models::MuLAN_MA{
         int id{};
 
         /**
-         * @brief Is the vertex active?
+         * @brief Slot of the vertex in the species store
+         *
+         */
+        std::size_t idx{};
+
+        /**
+         * @brief Species store of the domain
          *
          */
-        bool active = true;
+        store_t* store = nullptr;
 
         /**
          * @brief Pointer to organism
@@ -57,6 +70,21 @@ namespace Utopia::Models::MuLAN_MA{
          */
         typename ORG_T::org_ptr org;
 
+        /**
+         * @brief Is the vertex active?
+         *
+         * @return true
+         * @return false
+         */
+        [[nodiscard]] bool is_active() const;
+
+        /**
+         * @brief Activate or deactivate the vertex
+         *
+         * @param a
+         */
+        void set_active(bool a);
+
         /**
          * @brief Get the type of the organism
          *
@@ -85,13 +113,6 @@ namespace Utopia::Models::MuLAN_MA{
          */
         const trait_t& get_trait() const;
 
-        /**
-         * @brief Set the trait of teh organism
-         *
-         * @param new_trait
-         */
-        [[maybe_unused]] void set_trait(const trait_t& new_trait);
-
         /**
          * @brief Set the value/biomass of the organism
          *
@@ -100,41 +121,64 @@ namespace Utopia::Models::MuLAN_MA{
         void set_mass(const typename ORG_T::currency& new_mass);
 
         bool operator==(const vertex_wrapper_base v2) const {
-            return this->id == v2.id && this->org == v2.org && this->active == v2.active;
+            return this->id == v2.id && this->org == v2.org && this->is_active() == v2.is_active();
         }
 
         friend std::ostream& operator<< (std::ostream& stream, const vertex_wrapper_base v2) {
             stream << "[ Id: " << v2.id << " ";
             stream << "Organism: " << v2.org->parameters<< " ";
-            stream << "Active: " << v2.active<< " ] ";
+            stream << "Active: " << v2.is_active()<< " ] ";
             return stream;
         }
 
     };
 
 
+    /**
+     * @brief Organism type of a vertex wrapper type
+     * @details Extracts ORG_T without instantiating the vertex wrapper,
+     *          so it can be used while the domain type is still incomplete
+     *
+     * @tparam VERTEX_T
+     */
+    template <typename VERTEX_T>
+    struct vertex_organism;
+
+    template <template <typename> typename VW, typename ORG_T>
+    struct vertex_organism<VW<ORG_T> > {
+        using type = ORG_T;
+    };
+
+
     // Getter & Setter
 
     template <typename ORG_T>
-    const int& vertex_wrapper_base<ORG_T>::get_type() const {
-        return this->org->parameters.type;
+    bool vertex_wrapper_base<ORG_T>::is_active() const {
+        return this->store->active[this->idx];
     }
 
     template <typename ORG_T>
-    const typename ORG_T::currency& vertex_wrapper_base<ORG_T>::get_mass() const {
-        return this->org->get_value();
+    void vertex_wrapper_base<ORG_T>::set_active(bool a) {
+        if (a) {
+            this->store->activate(this->idx);
+        } else {
+            this->store->deactivate(this->idx);
+        }
     }
 
     template <typename ORG_T>
-    const typename vertex_wrapper_base<ORG_T>::trait_t& vertex_wrapper_base<ORG_T>::get_trait() const {
-        return this->org->parameters.trait;
+    const int& vertex_wrapper_base<ORG_T>::get_type() const {
+        return this->store->type[this->idx];
     }
 
     template <typename ORG_T>
-    [[maybe_unused]] void vertex_wrapper_base<ORG_T>::set_trait(const trait_t& new_trait) {
-
-        this->org->parameters.trait = new_trait;
+    const typename ORG_T::currency& vertex_wrapper_base<ORG_T>::get_mass() const {
+        return this->org->get_value();
+    }
 
+    template <typename ORG_T>
+    const typename vertex_wrapper_base<ORG_T>::trait_t& vertex_wrapper_base<ORG_T>::get_trait() const {
+        return this->store->trait[this->idx];
     }
 
     template <typename ORG_T>
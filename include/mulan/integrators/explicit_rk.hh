@@ -0,0 +1,642 @@
+#ifndef UTOPIA_MODELS_INTEGRATORS_EXPLICIT_RK
+#define UTOPIA_MODELS_INTEGRATORS_EXPLICIT_RK
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "integrator_store.hh"
+#include "step_controller.hh"
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Butcher tableau of Cash-Karp 5(4)
+     *
+     */
+    struct cash_karp {
+        static constexpr int stages = 6;
+        static constexpr int order = 5;
+        static constexpr int embedded_order = 4;
+        static constexpr bool fsal = false;
+
+        static constexpr double c[stages] = {0.0, 1.0 / 5.0, 3.0 / 10.0, 3.0 / 5.0, 1.0, 7.0 / 8.0};
+
+        static constexpr double a[stages][stages] = {
+            {},
+            {1.0 / 5.0},
+            {3.0 / 40.0, 9.0 / 40.0},
+            {3.0 / 10.0, -9.0 / 10.0, 6.0 / 5.0},
+            {-11.0 / 54.0, 5.0 / 2.0, -70.0 / 27.0, 35.0 / 27.0},
+            {1631.0 / 55296.0, 175.0 / 512.0, 575.0 / 13824.0, 44275.0 / 110592.0, 253.0 / 4096.0}
+        };
+
+        static constexpr double b[stages] = {37.0 / 378.0, 0.0, 250.0 / 621.0, 125.0 / 594.0, 0.0, 512.0 / 1771.0};
+
+        static constexpr double b_hat[stages] = {2825.0 / 27648.0, 0.0, 18575.0 / 48384.0, 13525.0 / 55296.0, 277.0 / 14336.0, 1.0 / 4.0};
+    };
+
+    /**
+     * @brief Butcher tableau of Dormand-Prince 5(4)
+     * @details The last stage is evaluated at the new value and becomes the first
+     *          stage of the next step (first same as last)
+     *
+     */
+    struct dormand_prince {
+        static constexpr int stages = 7;
+        static constexpr int order = 5;
+        static constexpr int embedded_order = 4;
+        static constexpr bool fsal = true;
+
+        static constexpr double c[stages] = {0.0, 1.0 / 5.0, 3.0 / 10.0, 4.0 / 5.0, 8.0 / 9.0, 1.0, 1.0};
+
+        static constexpr double a[stages][stages] = {
+            {},
+            {1.0 / 5.0},
+            {3.0 / 40.0, 9.0 / 40.0},
+            {44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0},
+            {19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0},
+            {9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0},
+            {35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0}
+        };
+
+        static constexpr double b[stages] = {35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0, 0.0};
+
+        static constexpr double b_hat[stages] = {5179.0 / 57600.0, 0.0, 7571.0 / 16695.0, 393.0 / 640.0, -92097.0 / 339200.0, 187.0 / 2100.0, 1.0 / 40.0};
+    };
+
+    /**
+     * @brief Butcher tableau of Bogacki-Shampine 3(2)
+     * @details First same as last
+     *
+     */
+    struct bogacki_shampine {
+        static constexpr int stages = 4;
+        static constexpr int order = 3;
+        static constexpr int embedded_order = 2;
+        static constexpr bool fsal = true;
+
+        static constexpr double c[stages] = {0.0, 1.0 / 2.0, 3.0 / 4.0, 1.0};
+
+        static constexpr double a[stages][stages] = {
+            {},
+            {1.0 / 2.0},
+            {0.0, 3.0 / 4.0},
+            {2.0 / 9.0, 1.0 / 3.0, 4.0 / 9.0}
+        };
+
+        static constexpr double b[stages] = {2.0 / 9.0, 1.0 / 3.0, 4.0 / 9.0, 0.0};
+
+        static constexpr double b_hat[stages] = {7.0 / 24.0, 1.0 / 4.0, 1.0 / 3.0, 1.0 / 8.0};
+    };
+
+    /**
+     * @brief Butcher tableau of the classic Runge-Kutta method
+     * @details No error estimate, the step size is not adapted
+     *
+     */
+    struct classic_rk4 {
+        static constexpr int stages = 4;
+        static constexpr int order = 4;
+        static constexpr int embedded_order = 0;
+        static constexpr bool fsal = false;
+
+        static constexpr double c[stages] = {0.0, 1.0 / 2.0, 1.0 / 2.0, 1.0};
+
+        static constexpr double a[stages][stages] = {
+            {},
+            {1.0 / 2.0},
+            {0.0, 1.0 / 2.0},
+            {0.0, 0.0, 1.0}
+        };
+
+        static constexpr double b[stages] = {1.0 / 6.0, 1.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0};
+
+        static constexpr double b_hat[stages] = {1.0 / 6.0, 1.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0};
+    };
+
+    /**
+     * @brief Explicit Runge-Kutta Integration Scheme
+     * @details Holds everything needed for integration. Perform Time step by performing step() 'steps' times.
+     *          The method is given by its Butcher tableau.
+     *
+     * @tparam TABLEAU Butcher tableau, e.g. cash_karp
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam ORG_T
+     */
+    template<typename TABLEAU, typename CURRENCY, typename ORG_T>
+    class explicit_rk {
+
+    public:
+        using currency = CURRENCY;
+        using tableau_t = TABLEAU;
+
+        /**
+         * @brief Global number of steps for the Integrator
+         * @details One per stage. With first same as last the first stage of a step
+         *          reuses the derivative of the last one and needs no sums.
+         *
+         */
+        inline static const int steps = TABLEAU::stages;
+
+        /**
+         * @brief Does the last stage give the derivative of the first stage of the next step
+         *
+         */
+        static constexpr bool fsal = TABLEAU::fsal;
+
+        /**
+         * @brief Is there an error estimate for the step size control
+         *
+         */
+        static constexpr bool adaptive = TABLEAU::embedded_order > 0;
+
+        /**
+         * @brief Do the stage updates solve linear systems with the Jacobian
+         *
+         */
+        static constexpr bool implicit = false;
+
+        // the last stage update uses x[1..3] as scratch
+        static_assert(TABLEAU::stages >= 4, "Tableaus need at least 4 stages");
+
+    private:
+        static constexpr int S = TABLEAU::stages;
+
+        /**
+         * @brief Backreference to the organism
+         *
+         */
+        ORG_T& org;
+
+        /**
+         * @brief Owned store if the integrator is not bound to a shared one
+         *
+         */
+        std::unique_ptr<integrator_store<currency> > own_store;
+
+        /**
+         * @brief Store holding stage values, k values, sums and error
+         *
+         */
+        integrator_store<currency>* store;
+
+        /**
+         * @brief Slot of this integrator in the store
+         *
+         */
+        std::size_t idx;
+
+        /**
+         * @brief Stage value N
+         *
+         * @param n
+         * @return currency&
+         */
+        currency& x(int n) {
+            return this->store->xs[n][this->idx];
+        }
+
+        /**
+         * @brief Stage k value N
+         *
+         * @param n
+         * @return currency&
+         */
+        currency& k(int n) {
+            return this->store->ks[n][this->idx];
+        }
+
+        /**
+         * @brief Count the step number
+         * @details One substep per stage
+         *
+         */
+        int stepnum = 0;
+
+        /**
+         * @brief Weights b - b_hat of the error estimate
+         *
+         */
+        struct error_weights {
+            double w[S];
+
+            constexpr error_weights() : w() {
+                for (int n = 0; n < S; ++n) {
+                    this->w[n] = TABLEAU::b[n] - TABLEAU::b_hat[n];
+                }
+            }
+        };
+
+        static constexpr error_weights e{};
+
+        /**
+         * @brief Raw stage arrays of a store
+         *
+         */
+        struct stage_view {
+            currency* x[S];
+            currency* k[S];
+            currency* last_dxdt;
+            currency* error;
+
+            explicit stage_view(integrator_store<currency>& s) : last_dxdt(s.last_dxdt.data()), error(s.error.data()) {
+                for (int n = 0; n < S; ++n) {
+                    this->x[n] = s.xs[n].data();
+                    this->k[n] = s.ks[n].data();
+                }
+            }
+        };
+
+        /**
+         * @brief Sum of w[j] * k[j] over the stages J of slot i
+         * @details Zero weights are skipped at compile time
+         *
+         * @tparam J
+         * @param w Weights
+         * @param v
+         * @param i
+         * @return currency
+         */
+        template<std::size_t... J>
+        static currency weighted(const double (&w)[S], const stage_view& v, std::size_t i, std::index_sequence<J...>) {
+            currency sum = 0.0;
+            ((w[J] != 0.0 ? sum += w[J] * v.k[J][i] : sum), ...);
+            return sum;
+        }
+
+        /**
+         * @brief Error estimate of slot i
+         * @details Difference of the new value to the one of the embedded method
+         *
+         * @param v
+         * @param i
+         * @param dt
+         * @return currency
+         */
+        static currency error_of(const stage_view& v, std::size_t i, double dt) {
+            return weighted(e.w, v, i, std::make_index_sequence<S>{}) * dt;
+        }
+
+        /**
+         * @brief Stage update of slot i
+         * @details Next stage value from the k values up to N. The last stage
+         *          sets the new value, the change and the error estimate.
+         *
+         * @tparam N
+         * @param v
+         * @param i
+         * @param dt
+         */
+        template<int N>
+        static void update(const stage_view& v, std::size_t i, double dt) {
+            if constexpr (N < S - 1) {
+                v.x[N + 1][i] = v.x[0][i] + dt * weighted(TABLEAU::a[N + 1], v, i, std::make_index_sequence<N + 1>{});
+            } else {
+                v.last_dxdt[i] = weighted(TABLEAU::b, v, i, std::make_index_sequence<S>{});
+                if constexpr (adaptive) {
+                    v.error[i] = error_of(v, i, dt);
+                }
+                if constexpr (fsal) {
+                    // the last stage was evaluated at the new value
+                    v.x[0][i] = v.x[S - 1][i];
+                    v.k[0][i] = v.k[S - 1][i];
+                } else {
+                    v.x[0][i] = v.x[0][i] + v.last_dxdt[i] * dt;
+                }
+            }
+        }
+
+        /**
+         * @brief Copy the active slots of src to dst
+         *
+         * @param active
+         * @param size
+         * @param src
+         * @param dst
+         */
+        static void select(const char* active, std::size_t size, const currency* src, currency* dst) {
+            for (std::size_t i = 0; i < size; ++i) {
+                dst[i] = active[i] ? src[i] : dst[i];
+            }
+        }
+
+        /**
+         * @brief Stage update of all slots
+         * @details The intermediate stages are updated for all slots, the values of
+         *          inactive ones are never read. The last stage computes the results
+         *          into the stage arrays x[1..3], which are free again, and copies
+         *          them for the active slots only. Branch free so the loops vectorize.
+         *
+         * @tparam N
+         * @param s
+         * @param active
+         * @param dt
+         */
+        template<int N>
+        static void stage_update(integrator_store<currency>& s, const char* active, double dt) {
+            const stage_view v(s);
+            const std::size_t size = s.size();
+
+            if constexpr (N < S - 1) {
+                for (std::size_t i = 0; i < size; ++i) {
+                    update<N>(v, i, dt);
+                }
+            } else {
+                currency* const last_dxdt = v.x[1];
+                currency* const error = v.x[2];
+                currency* const x = fsal ? v.x[S - 1] : v.x[3];
+
+                for (std::size_t i = 0; i < size; ++i) {
+                    last_dxdt[i] = weighted(TABLEAU::b, v, i, std::make_index_sequence<S>{});
+                }
+                if constexpr (!fsal) {
+                    for (std::size_t i = 0; i < size; ++i) {
+                        x[i] = v.x[0][i] + last_dxdt[i] * dt;
+                    }
+                }
+                if constexpr (adaptive) {
+                    for (std::size_t i = 0; i < size; ++i) {
+                        error[i] = error_of(v, i, dt);
+                    }
+                    select(active, size, error, v.error);
+                }
+
+                select(active, size, last_dxdt, v.last_dxdt);
+                select(active, size, x, v.x[0]);
+
+                if constexpr (fsal) {
+                    std::copy(v.k[S - 1], v.k[S - 1] + size, v.k[0]);
+                    s.fsal_ready = true;
+                }
+            }
+        }
+
+        /**
+         * @brief Select stage n at compile time
+         *
+         * @tparam N
+         * @tparam F
+         * @param n
+         * @param f Called with std::integral_constant<int, n>
+         */
+        template<int N, typename F>
+        static void stage_iter(int n, F&& f) {
+            if constexpr (N < S) {
+                if (n == N) {
+                    f(std::integral_constant<int, N>{});
+                } else {
+                    stage_iter<N + 1>(n, f);
+                }
+            }
+        }
+
+    public:
+
+        /**
+         * @brief Error Threshold
+         * @details Estimate time step with error and w_error
+         *
+         */
+        inline static currency w_error = 0.1;
+
+        /**
+         * @brief Construct a new integrator with its own store
+         *
+         * @param org
+         */
+        explicit explicit_rk(ORG_T& org) : org(org),
+                                           own_store(std::make_unique<integrator_store<currency> >()),
+                                           store(own_store.get()),
+                                           idx(0) {
+            this->store->reserve_stages(steps);
+            this->idx = this->store->emplace_back();
+        };
+
+        /**
+         * @brief Construct a new integrator as view on a new slot of a shared store
+         *
+         * @tparam STORE Store type derived from integrator_store
+         * @param org
+         * @param store
+         */
+        template <typename STORE>
+        explicit_rk(ORG_T& org, STORE& store) : org(org), store(&store), idx(0) {
+            this->store->reserve_stages(steps);
+            this->idx = store.emplace_back();
+        };
+
+        /**
+         * @brief Get the store
+         *
+         * @return integrator_store<currency>&
+         */
+        integrator_store<currency>& get_store() {
+            return *this->store;
+        }
+
+        /**
+         * @brief Get the slot in the store
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t get_index() const {
+            return this->idx;
+        }
+
+        /**
+         * @brief Move the view to another slot of the store
+         * @details Used when the store is compacted
+         *
+         * @param i
+         */
+        void set_index(std::size_t i) {
+            this->idx = i;
+        }
+
+        /**
+         * @brief Change of the previous step
+         *
+         * @return currency&
+         */
+        currency& get_last_dxdt() {
+            return this->store->last_dxdt[this->idx];
+        }
+
+        /**
+         * @brief Get the value
+         *
+         * @return currency&
+         */
+        currency& get_value() {
+            return this->store->xs[this->stepnum][this->idx];
+        }
+
+        /**
+         * @brief Get the value
+         *
+         * @return const currency&
+         */
+        const currency& get_value() const {
+            return this->store->xs[this->stepnum][this->idx];
+        }
+
+        /**
+         * @brief Get Error
+         *
+         * @return const currency&
+         */
+        const currency& get_error() const {
+            return this->store->error[this->idx];
+        }
+
+        /**
+         * @brief Set the value
+         * @details The derivative of the last stage does not belong to the new value
+         *
+         * @param val
+         */
+        void set_value(const currency& val) {
+            this->store->xs[this->stepnum][this->idx] = val;
+            this->store->fsal_ready = false;
+        }
+
+        /**
+         * @brief Access sum
+         *
+         * @tparam T
+         * @param i
+         * @return currency&
+         */
+        template <typename T>
+        currency& operator[] (const T& i) {
+            static_assert(std::is_integral_v<T>, "i has to be integral");
+            return this->store->sum[i][this->idx];
+
+        }
+
+        template <typename T>
+        const currency& operator[] (const T& i) const {
+            static_assert(std::is_integral_v<T>, "i has to be integral");
+            return this->store->sum[i][this->idx];
+        }
+
+        /**
+         * @brief Clear the sum
+         *
+         */
+        void clear_sum(){
+            for (auto& s : this->store->sum) {
+                s[this->idx] = 0.0;
+            }
+        }
+
+        /**
+         * @brief Derivative of the current stage
+         * @details Batched stepping: instead of step(), the k value of every species
+         *          is computed first and the stage values of all species are then
+         *          updated at once by stage_update(). The first stage is skipped if
+         *          the store holds the derivative of the last one.
+         *
+         * @tparam SELF Dynamic type of the organism if known, allows static dispatch of dxdt
+         * @param dt
+         */
+        template <typename SELF = ORG_T>
+        void derive(double dt){
+            if (!(fsal && this->stepnum == 0 && this->store->fsal_ready)) {
+                SELF& org = static_cast<SELF&>(this->org);
+                this->k(this->stepnum) = org.dxdt(this->x(this->stepnum), TABLEAU::c[this->stepnum] * dt);
+            }
+            this->stepnum = (this->stepnum + 1) % steps;
+        }
+
+        /**
+         * @brief Update the stage values of all active slots of a store
+         * @details One vectorizable sweep over the contiguous arrays after derive()
+         *          was called for every active slot. Inactive slots are left untouched.
+         *
+         * @param s
+         * @param active Active flag of each slot
+         * @param n Stage
+         * @param dt
+         */
+        static void stage_update(integrator_store<currency>& s, const char* active, int n, double dt) {
+            stage_iter<0>(n, [&](auto stage){ stage_update<decltype(stage)::value>(s, active, dt); });
+        }
+
+        /**
+         * @brief Step
+         * @details Iterate over steps by calling step() 'steps' times. Between calls sums should be calculated
+         *
+         * @tparam SELF Dynamic type of the organism if known, allows static dispatch of dxdt
+         * @param dt
+         */
+        template <typename SELF = ORG_T>
+        void step(double dt){
+            const int n = this->stepnum;
+            this->template derive<SELF>(dt);
+            stage_iter<0>(n, [&](auto stage){
+                update<decltype(stage)::value>(stage_view(*this->store), this->idx, dt);
+            });
+            if (fsal && n == S - 1) {
+                this->store->fsal_ready = true;
+            }
+        }
+
+        /**
+         * @brief resize sum vector
+         *
+         * @param size
+         */
+        void resize(const int& size){
+            this->store->reserve_sums(size);
+        }
+
+        /**
+         * @brief Calculate new step size individual level
+         * @details Use this to calculate new step size based on individual error.
+         *          The error norm is taken over the whole store in calc_new_step_size()
+         *
+         * @param dt
+         * @param new_dt
+         */
+        virtual void calc_new_step_size_s(double /*dt*/, double& /*new_dt*/) {
+
+        }
+
+        /**
+         * @brief Calculate new step size on global level
+         * @details Error norm (max or RMS) over the active slots, each error relative
+         *          to w_error + rtol * max(|x_old|, |x_new|). The controller decides on
+         *          acceptance and the next step size. A rejected step has to be
+         *          repeated from the old values with new_dt.
+         *
+         * @param s
+         * @param active Slots in the norm
+         * @param dt
+         * @param new_dt Smallest proposal of calc_new_step_size_s(), replaced by the step size of the controller
+         * @param controller
+         * @return bool Step accepted
+         */
+        static bool calc_new_step_size(const integrator_store<currency>& s, const char* active, double dt, double& new_dt, step_controller& controller) {
+            if constexpr (adaptive) {
+                const double err = controller.error_norm(s, active, w_error, dt);
+
+                double proposal;
+                const bool accept = controller.propose(err, dt, TABLEAU::embedded_order + 1, proposal);
+
+                new_dt = accept ? std::min(new_dt, proposal) : proposal;
+
+                return accept;
+            }
+            return true;
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_INTEGRATORS_EXPLICIT_RK
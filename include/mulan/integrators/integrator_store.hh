@@ -0,0 +1,167 @@
+#ifndef UTOPIA_MODELS_INTEGRATORS_STORE
+#define UTOPIA_MODELS_INTEGRATORS_STORE
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Keep only the given entries of v
+     * @details Entry keep[n] becomes entry n. In place if keep is sorted ascending.
+     *
+     * @tparam T
+     * @param v
+     * @param keep Entries to keep
+     */
+    template <typename T>
+    void compact_slots(std::vector<T>& v, const std::vector<std::size_t>& keep) {
+        if (std::is_sorted(keep.begin(), keep.end())) {
+            for (std::size_t n = 0; n < keep.size(); ++n) {
+                v[n] = std::move(v[keep[n]]);
+            }
+            v.resize(keep.size());
+        } else {
+            std::vector<T> tmp;
+            tmp.reserve(keep.size());
+            for (auto i : keep) {
+                tmp.push_back(std::move(v[i]));
+            }
+            v.swap(tmp);
+        }
+    }
+
+    /**
+     * @brief Structure-of-arrays store for integrator states
+     * @details Holds stage values, k values, sums and error estimates of many
+     *          species in contiguous arrays. Every species owns one slot i,
+     *          e.g. xs[n][i] is the value of stage n of the species in slot i.
+     *          Integrators are views on one slot of such a store.
+     *
+     * @tparam CURRENCY The currency (e.g. double)
+     */
+    template <typename CURRENCY>
+    struct integrator_store {
+
+        using currency = CURRENCY;
+
+        /**
+         * @brief Stage values
+         * @details xs[0] holds the values/biomasses, others temp values for substeps
+         *
+         */
+        std::vector<std::vector<currency> > xs;
+
+        /**
+         * @brief Stage k values
+         *
+         */
+        std::vector<std::vector<currency> > ks;
+
+        /**
+         * @brief Sums of the differential equations
+         * @details sum[l][i] is sum l of the species in slot i
+         *
+         */
+        std::vector<std::vector<currency> > sum;
+
+        /**
+         * @brief Error estimate of the last step
+         *
+         */
+        std::vector<currency> error;
+
+        /**
+         * @brief Change of the previous step
+         *
+         */
+        std::vector<currency> last_dxdt;
+
+        /**
+         * @brief The k values of the first stage are those of the last stage of the previous step
+         * @details Set by integrators whose last stage is evaluated at the new value
+         *          (first same as last), cleared whenever a value or the equations change
+         *
+         */
+        bool fsal_ready = false;
+
+        /**
+         * @brief Number of slots
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t size() const {
+            return this->error.size();
+        }
+
+        /**
+         * @brief Append a new slot initialized with zeros
+         *
+         * @return std::size_t Index of the new slot
+         */
+        std::size_t emplace_back() {
+            for (auto& v : this->xs) {
+                v.push_back(0.0);
+            }
+            for (auto& v : this->ks) {
+                v.push_back(0.0);
+            }
+            for (auto& v : this->sum) {
+                v.push_back(0.0);
+            }
+            this->error.push_back(0.0);
+            this->last_dxdt.push_back(0.0);
+            this->fsal_ready = false;
+
+            return this->size() - 1;
+        }
+
+        /**
+         * @brief Keep only the given slots
+         * @details Slot keep[n] becomes slot n
+         *
+         * @param keep Slots to keep
+         */
+        void compact(const std::vector<std::size_t>& keep) {
+            for (auto& v : this->xs) {
+                compact_slots(v, keep);
+            }
+            for (auto& v : this->ks) {
+                compact_slots(v, keep);
+            }
+            for (auto& v : this->sum) {
+                compact_slots(v, keep);
+            }
+            compact_slots(this->error, keep);
+            compact_slots(this->last_dxdt, keep);
+        }
+
+        /**
+         * @brief Make sure there are at least n stages
+         *
+         * @param n Number of stages
+         */
+        void reserve_stages(std::size_t n) {
+            if (this->xs.size() < n) {
+                this->xs.resize(n, std::vector<currency>(this->size(), 0.0));
+                this->ks.resize(n, std::vector<currency>(this->size(), 0.0));
+            }
+        }
+
+        /**
+         * @brief Make sure there are at least n sums
+         *
+         * @param n Number of sums
+         */
+        void reserve_sums(std::size_t n) {
+            if (this->sum.size() < n) {
+                this->sum.resize(n, std::vector<currency>(this->size(), 0.0));
+            }
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_INTEGRATORS_STORE
@@ -2,6 +2,13 @@
 #define UTOPIA_MODELS_INTEGRATORS_RKCK
 
 #include <cmath>
+#include <memory>
+#include <type_traits>
+
+#include "explicit_rk.hh"
+#include "integrator_store.hh"
+#include "rosenbrock.hh"
+#include "step_controller.hh"
 
 namespace Utopia::Models::MuLAN_MA {
 
@@ -27,291 +34,116 @@ namespace Utopia::Models::MuLAN_MA {
         ORG_T& org;
 
         /**
-         * @brief Hold values
-         * @details xs[0] holds value/biomass of the organism. Others temp values for substeps
+         * @brief Owned store if the integrator is not bound to a shared one
          *
          */
-        currency x;
+        std::unique_ptr<integrator_store<currency> > own_store;
 
         /**
-         * @brief Store here every sum in the differential equations
-         * @details If the k values depend on sums (coupled diff. eq.) perform summing between substeps
+         * @brief Store holding value, sums and last change
          *
          */
-        std::vector<currency> sum;
-
-    public:
+        integrator_store<currency>* store;
 
         /**
-         * @brief Global number of steps for the Integrator
+         * @brief Slot of this integrator in the store
          *
          */
-        inline static const int steps = 1;
-
-        /**
-         * @brief Store change of the previous step
-         *
-         */
-        currency last_dxdt = 0.0;
+        std::size_t idx;
 
+    public:
 
         /**
-         * @brief Store previous step-size
+         * @brief Global number of steps for the Integrator
          *
          */
-        currency last_dt = 0.0;
+        inline static const int steps = 1;
 
         /**
-         * @brief Construct a new euler object
+         * @brief Does the last stage give the derivative of the first stage of the next step
          *
-         * @param org
          */
-        explicit euler(ORG_T& org) : org(org){
-
-        };
+        static constexpr bool fsal = false;
 
         /**
-         * @brief Get the value
+         * @brief Is there an error estimate for the step size control
          *
-         * @return currency&
          */
-        currency& get_value() {
-            return this->x;
-        }
+        static constexpr bool adaptive = false;
 
         /**
-         * @brief Get the value
+         * @brief Do the stage updates solve linear systems with the Jacobian
          *
-         * @return const currency&
          */
-        const currency& get_value() const {
-            return this->x;
-        }
+        static constexpr bool implicit = false;
 
         /**
-         * @brief Get Error
-         *
-         * @return currency&
-         */
-        currency get_error() const {
-            return 0.5 * this->last_dxdt * this->last_dt * this->last_dt;
-        }
-
-        /**
-         * @brief Set the value
+         * @brief Store previous step-size
          *
-         * @param val
          */
-        void set_value(const currency& val) {
-            this->x = val;
-        }
-
-        /**
-         * @brief Access sum
-         *
-         * @tparam T
-         * @param i
-         * @return currency&
-         */
-        template <typename T>
-        currency& operator[] (const T& i) {
-            static_assert(std::is_integral_v<T>, "i has to be integral");
-            return this->sum[i];
-
-        }
-
-        template <typename T>
-        const currency& operator[] (const T& i) const {
-            static_assert(std::is_integral_v<T>, "i has to be integral");
-            return this->sum[i];
-        }
+        currency last_dt = 0.0;
 
         /**
-         * @brief Clear the sum
+         * @brief Construct a new euler object with its own store
          *
+         * @param org
          */
-        void clear_sum(){
-            std::fill(this->sum.begin(), this->sum.end(), 0.0);
-        }
+        explicit euler(ORG_T& org) : org(org),
+                                     own_store(std::make_unique<integrator_store<currency> >()),
+                                     store(own_store.get()),
+                                     idx(0) {
+            this->store->reserve_stages(steps);
+            this->idx = this->store->emplace_back();
+        };
 
         /**
-         * @brief Step
-         * @details Iterate over steps by calling step() 6 times. Between calls sums should be calculated
+         * @brief Construct a new euler object as view on a new slot of a shared store
          *
-         * @param dt
+         * @tparam STORE Store type derived from integrator_store
+         * @param org
+         * @param store
          */
-        void step(double dt){
-            this->last_dt = dt;
-            this->last_dxdt = org.dxdt(this->x, 0.0);
-            this->x = this->x + this->last_dxdt * dt;
-        }
+        template <typename STORE>
+        euler(ORG_T& org, STORE& store) : org(org), store(&store), idx(0) {
+            this->store->reserve_stages(steps);
+            this->idx = store.emplace_back();
+        };
 
         /**
-         * @brief resize sum vector
+         * @brief Get the slot in the store
          *
-         * @param size
+         * @return std::size_t
          */
-        void resize(const int& size){
-            this->sum.resize(size);
+        [[nodiscard]] std::size_t get_index() const {
+            return this->idx;
         }
 
         /**
-         * @brief Calculate new step size individual level
-         * @details Use this to calculate new step size based on individual error
+         * @brief Move the view to another slot of the store
+         * @details Used when the store is compacted
          *
-         * @param dt
-         * @param new_dt
+         * @param i
          */
-        virtual void calc_new_step_size_s(double /*dt*/, double& /*new_dt*/) {
-
+        void set_index(std::size_t i) {
+            this->idx = i;
         }
 
         /**
-         * @brief Calculate new step size on global level
-         * @details Use this to calculate new step size based on global error. Calculate e.g. sums over errors in calc_new_step_size_s()
+         * @brief Change of the previous step
          *
-         * @param dt
-         * @param new_dt
+         * @return currency&
          */
-        static void calc_new_step_size(double /*dt*/, double& /*new_dt*/) {
-
+        currency& get_last_dxdt() {
+            return this->store->last_dxdt[this->idx];
         }
 
-    };
-
-    /**
-     * @brief Integration Scheme for Runge-Kutta Cash-Karp
-     * @details Holds everything needed for integration. Perform Time step by performing step() 'steps' times
-     *
-     * @tparam CURRENCY The currency (e.g. double)
-     * @tparam ORG_T
-     */
-    template<typename CURRENCY, typename ORG_T>
-    class rkck {
-
-    public:
-        using currency = CURRENCY;
-
-    private:
-        /**
-         * @brief Backreference to the organism
-         *
-         */
-        ORG_T& org;
-
-        /**
-         * @brief Error
-         * @details Estimated by scheme
-         *
-         */
-        currency error;
-
-        /**
-         * @brief Count the step number
-         * @details RKCK performs 6 substeps
-         *
-         */
-        int stepnum = 0;
-
-
-        /**
-         * @brief Safety Factor
-         * @details Limits growth of timestep
-         *
-         */
-        double beta = 0.95;
-
-        /**
-         * @brief Integration Scheme
-         * @details Perform Substeps according to RKCK definition
-         *
-         * @tparam N
-         * @param dt
-         */
-        template<int N>
-        void substep(double dt){
-            if constexpr (N == 0) {
-                this->ks[0] = org.dxdt(this->xs[0], 0.0);
-                this->xs[1] = this->xs[0] + this->ks[0] * dt / 5.0;
-            } else if constexpr (N == 1) {
-                this->ks[1] = org.dxdt(this->xs[1], dt / 5.0);
-                this->xs[2] = this->xs[0] + this->ks[0] * (3.0/ 40.0) + this->ks[1] * dt * (9.0/ 40.0);
-            } else if constexpr (N == 2) {
-                this->ks[2] = org.dxdt(this->xs[2], (3.0 / 10.0) * dt);
-                this->xs[3] = this->xs[0] + this->ks[0] * (3.0 / 10.0) * dt - this->ks[1] * (9.0/10.0) * dt  + this->ks[2] * (6.0 / 5.0) * dt;
-            } else if constexpr (N == 3) {
-                this->ks[3] = org.dxdt(this->xs[3], (3.0 / 5.0) * dt);
-                this->xs[4] = this->xs[0] - this->ks[0] * (11.0 / 54.0) * dt + this->ks[1] * (5.0/2.0) * dt  - this->ks[2] * (70.0 / 27.0) * dt + this->ks[3] * (35.0 / 27.0) * dt ;
-            } else if constexpr (N == 4) {
-                this->ks[4] = org.dxdt(this->xs[4], dt);
-                this->xs[5] = this->xs[0] + this->ks[0] * (1631.0 / 55296.0) * dt + this->ks[1] * (175.0/512.0) * dt  + this->ks[2] * (575.0 / 13824.0) * dt + this->ks[3] * (44275.0 / 110592.0) * dt + this->ks[4] * (253.0 / 4096.0) * dt ;
-            } else if constexpr (N == 5) {
-                this->ks[5] = org.dxdt(this->xs[5], (7.0 / 8.0) * dt);
-                this->last_dxdt = (this->ks[0] * (37.0/378.0) + this->ks[2] * (250.0/621.0) + this->ks[3] * (125.0/594.0) + this->ks[5] * (512.0/1771.0));
-                this->xs[0] = this->xs[0] + this->last_dxdt * dt;
-                this->error = this->xs[0] - (this->xs[0] + ( (2825.0 / 27648.0) * this->ks[0] + (18575.0 / 48384.0) * this->ks[2] + (13525.0 / 55296.0) * this->ks[3] + (277.0 / 14336.0) * this->ks[4] + (1.0 / 4.0) * this->ks[5]) * dt);   
-            }
-        };
-
-        /**
-         * @brief Hold values
-         * @details xs[0] holds value/biomass of the organism. Others temp values for substeps
-         *
-         */
-        std::array<currency,6> xs;
-
-        /**
-         * @brief Hold k values
-         * @details Needed for substeps
-         *
-         */
-        std::array<currency,6> ks;
-
-        /**
-         * @brief Store here every sum in the differential equations
-         * @details If the k values depend on sums (coupled diff. eq.) perform summing between substeps
-         *
-         */
-        std::vector<currency> sum;
-
-    public:
-
-        /**
-         * @brief Error Threshold
-         * @details Estimate time step with error and w_error
-         *
-         */
-        inline static currency w_error = 0.1;
-
-        /**
-         * @brief Global number of steps for the Integrator
-         *
-         */
-        inline static const int steps = 6;
-        [[maybe_unused]] inline static const int error_step = 5;
-
-        /**
-         * @brief Store change of the previous step
-         *
-         */
-        currency last_dxdt = 0.0;
-
-        /**
-         * @brief Construct a new rkck object
-         *
-         * @param org
-         */
-        explicit rkck(ORG_T& org) : org(org){
-
-        };
-
         /**
          * @brief Get the value
          *
          * @return currency&
          */
         currency& get_value() {
-            return this->xs[this->stepnum];
+            return this->store->xs[0][this->idx];
         }
 
         /**
@@ -320,34 +152,34 @@ namespace Utopia::Models::MuLAN_MA {
          * @return const currency&
          */
         const currency& get_value() const {
-            return this->xs[this->stepnum];
+            return this->store->xs[0][this->idx];
         }
 
         /**
-         * @brief Get Error
+         * @brief Get the store
          *
-         * @return const currency&
+         * @return integrator_store<currency>&
          */
-        const currency& get_error() const {
-            return this->error;
+        integrator_store<currency>& get_store() {
+            return *this->store;
         }
 
         /**
-         * @brief Set the value
+         * @brief Get Error
          *
-         * @param val
+         * @return currency&
          */
-        void set_value(const currency& val) {
-            this->xs[this->stepnum] = val;
+        currency get_error() const {
+            return 0.5 * this->store->last_dxdt[this->idx] * this->last_dt * this->last_dt;
         }
 
         /**
-         * @brief Set the safety value
+         * @brief Set the value
          *
          * @param val
          */
-        void set_beta(const double& val) {
-            this->beta = val;
+        void set_value(const currency& val) {
+            this->store->xs[0][this->idx] = val;
         }
 
         /**
@@ -360,14 +192,14 @@ namespace Utopia::Models::MuLAN_MA {
         template <typename T>
         currency& operator[] (const T& i) {
             static_assert(std::is_integral_v<T>, "i has to be integral");
-            return this->sum[i];
+            return this->store->sum[i][this->idx];
 
         }
 
         template <typename T>
         const currency& operator[] (const T& i) const {
             static_assert(std::is_integral_v<T>, "i has to be integral");
-            return this->sum[i];
+            return this->store->sum[i][this->idx];
         }
 
         /**
@@ -375,31 +207,61 @@ namespace Utopia::Models::MuLAN_MA {
          *
          */
         void clear_sum(){
-            std::fill(this->sum.begin(), this->sum.end(), 0.0);
+            for (auto& s : this->store->sum) {
+                s[this->idx] = 0.0;
+            }
         }
 
         /**
          * @brief Step
          * @details Iterate over steps by calling step() 6 times. Between calls sums should be calculated
          *
+         * @tparam SELF Dynamic type of the organism if known, allows static dispatch of dxdt
          * @param dt
          */
+        template <typename SELF = ORG_T>
         void step(double dt){
-            if (this->stepnum == 0) {
-                this->substep<0>(dt);
-            } else if (this->stepnum == 1) {
-                this->substep<1>(dt);
-            }else if (this->stepnum == 2) {
-                this->substep<2>(dt);
-            }else if (this->stepnum == 3) {
-                this->substep<3>(dt);
-            }else if (this->stepnum == 4) {
-                this->substep<4>(dt);
-            }else if (this->stepnum == 5) {
-                this->substep<5>(dt);
-                this->stepnum = -1;
+            SELF& org = static_cast<SELF&>(this->org);
+            currency& x = this->get_value();
+            currency& last_dxdt = this->get_last_dxdt();
+            this->last_dt = dt;
+            last_dxdt = org.dxdt(x, 0.0);
+            x = x + last_dxdt * dt;
+        }
+
+        /**
+         * @brief Derivative of the current stage
+         * @details Batched stepping: the values of all species are updated afterwards by stage_update()
+         *
+         * @tparam SELF Dynamic type of the organism if known, allows static dispatch of dxdt
+         * @param dt
+         */
+        template <typename SELF = ORG_T>
+        void derive(double dt){
+            SELF& org = static_cast<SELF&>(this->org);
+            this->last_dt = dt;
+            this->get_last_dxdt() = org.dxdt(this->get_value(), 0.0);
+        }
+
+        /**
+         * @brief Update the values of all active slots of a store
+         * @details Second half of step() for the whole store, see derive()
+         *
+         * @param s
+         * @param active Active flag of each slot
+         * @param n Stage
+         * @param dt
+         */
+        static void stage_update(integrator_store<currency>& s, const char* active, int /*n*/, double dt) {
+            currency* const x = s.xs[0].data();
+            const currency* const last_dxdt = s.last_dxdt.data();
+            const std::size_t size = s.size();
+
+            for (std::size_t i = 0; i < size; ++i) {
+                if (active[i]) {
+                    x[i] = x[i] + last_dxdt[i] * dt;
+                }
             }
-            this->stepnum++;
         }
 
         /**
@@ -408,7 +270,7 @@ namespace Utopia::Models::MuLAN_MA {
          * @param size
          */
         void resize(const int& size){
-            this->sum.resize(size);
+            this->store->reserve_sums(size);
         }
 
         /**
@@ -418,13 +280,7 @@ namespace Utopia::Models::MuLAN_MA {
          * @param dt
          * @param new_dt
          */
-        virtual void calc_new_step_size_s(double dt, double& new_dt) {
-            double err_q = fabs(this->w_error / this->error);
-            if ( err_q < 1.0 ) {
-                new_dt = std::min(new_dt, this->beta * dt * pow(err_q, 0.2));
-            } else {
-                new_dt = std::min(new_dt, this->beta * dt * pow(err_q, 0.25));
-            }
+        virtual void calc_new_step_size_s(double /*dt*/, double& /*new_dt*/) {
 
         }
 
@@ -432,15 +288,90 @@ namespace Utopia::Models::MuLAN_MA {
          * @brief Calculate new step size on global level
          * @details Use this to calculate new step size based on global error. Calculate e.g. sums over errors in calc_new_step_size_s()
          *
+         * @param s
+         * @param active Active flag of each slot
          * @param dt
          * @param new_dt
+         * @param controller
+         * @return bool Step accepted
          */
-        static void calc_new_step_size(double /*dt*/, double& /*new_dt*/) {
-
+        static bool calc_new_step_size(const integrator_store<currency>& /*s*/, const char* /*active*/, double /*dt*/, double& /*new_dt*/, step_controller& /*controller*/) {
+            return true;
         }
 
     };
 
+    /**
+     * @brief Integration Scheme for Runge-Kutta Cash-Karp
+     *
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam ORG_T
+     */
+    template<typename CURRENCY, typename ORG_T>
+    using rkck = explicit_rk<cash_karp, CURRENCY, ORG_T>;
+
+    /**
+     * @brief Integration Scheme for Dormand-Prince 5(4)
+     *
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam ORG_T
+     */
+    template<typename CURRENCY, typename ORG_T>
+    using dopri5 = explicit_rk<dormand_prince, CURRENCY, ORG_T>;
+
+    /**
+     * @brief Integration Scheme for Bogacki-Shampine 3(2)
+     *
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam ORG_T
+     */
+    template<typename CURRENCY, typename ORG_T>
+    using bs32 = explicit_rk<bogacki_shampine, CURRENCY, ORG_T>;
+
+    /**
+     * @brief Integration Scheme for the classic Runge-Kutta method
+     *
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam ORG_T
+     */
+    template<typename CURRENCY, typename ORG_T>
+    using rk4 = explicit_rk<classic_rk4, CURRENCY, ORG_T>;
+
+    /**
+     * @brief Integration Scheme for the stiff Rosenbrock-W method ROS34PW2
+     *
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam ORG_T
+     */
+    template<typename CURRENCY, typename ORG_T>
+    using ros34pw2 = rosenbrock<rang_angermann, CURRENCY, ORG_T>;
+
+    /**
+     * @brief Integration Scheme selected by the 'integrator' config entry
+     * @details 0: rkck, 1: euler, 2: dopri5, 3: bs32, 4: rk4, 5: ros34pw2.
+     *          Other ids do not compile.
+     *
+     * @tparam INTEGRATOR
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam ORG_T
+     */
+    template<int INTEGRATOR, typename CURRENCY, typename ORG_T>
+    struct integrator_select {
+
+        static_assert(INTEGRATOR >= 0 && INTEGRATOR <= 5, "No valid integrator id. Use 0 to 5.");
+
+        using type = std::conditional_t< INTEGRATOR == 0, rkck<CURRENCY, ORG_T>,
+                     std::conditional_t< INTEGRATOR == 1, euler<CURRENCY, ORG_T>,
+                     std::conditional_t< INTEGRATOR == 2, dopri5<CURRENCY, ORG_T>,
+                     std::conditional_t< INTEGRATOR == 3, bs32<CURRENCY, ORG_T>,
+                     std::conditional_t< INTEGRATOR == 4, rk4<CURRENCY, ORG_T>,
+                     std::conditional_t< INTEGRATOR == 5, ros34pw2<CURRENCY, ORG_T>,
+                                                          void > > > > > >;
+    };
+
+    template<int INTEGRATOR, typename CURRENCY, typename ORG_T>
+    using integrator_of = typename integrator_select<INTEGRATOR, CURRENCY, ORG_T>::type;
+
 } // namespace Utopia::Models::MuLAN_MA
 
 #endif //UTOPIA_MODELS_INTEGRATORS_RKCK
@@ -0,0 +1,575 @@
+#ifndef UTOPIA_MODELS_INTEGRATORS_ROSENBROCK
+#define UTOPIA_MODELS_INTEGRATORS_ROSENBROCK
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "integrator_store.hh"
+#include "sparse_jacobian.hh"
+#include "step_controller.hh"
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Coefficients of ROS34PW2 (Rang and Angermann 2005)
+     * @details Rosenbrock-W method of order 3 with an embedded method of order 2,
+     *          L-stable and stiffly accurate. A W-method keeps its order with an
+     *          approximate or outdated Jacobian.
+     *
+     */
+    struct rang_angermann {
+        static constexpr int stages = 4;
+        static constexpr int order = 3;
+        static constexpr int embedded_order = 2;
+
+        static constexpr double gamma = 4.3586652150845900e-01;
+
+        static constexpr double alpha[stages][stages] = {
+            {},
+            {8.7173304301691801e-01},
+            {8.4457060015369423e-01, -1.1299064236484185e-01},
+            {0.0, 0.0, 1.0}
+        };
+
+        // below the diagonal, the diagonal is gamma
+        static constexpr double gamma_ij[stages][stages] = {
+            {},
+            {-8.7173304301691801e-01},
+            {-9.0338057013044082e-01, 5.4180672388095326e-02},
+            {2.4212380706095346e-01, -1.2232505839045147e+00, 5.4526025533510214e-01}
+        };
+
+        static constexpr double b[stages] = {2.4212380706095346e-01, -1.2232505839045147e+00, 1.5452602553351020e+00, 4.3586652150845900e-01};
+
+        static constexpr double b_hat[stages] = {3.7810903145819369e-01, -9.6042292212423178e-02, 5.0000000000000000e-01, 2.1793326075422950e-01};
+    };
+
+    /**
+     * @brief Linearly Implicit Rosenbrock Integration Scheme
+     * @details Stage n solves (I / (gamma dt) - J) u_n = f(x_n) + sum_j c_nj / dt u_j
+     *          with the Jacobian J of the whole community, so the stage updates
+     *          need the linear system of the domain (see stage_update()).
+     *          The stages use the transformed coefficients of Hairer and Wanner
+     *          (no products with J). The time derivative of f is neglected.
+     *
+     *          step() is for isolated organisms only, it takes the derivative of
+     *          dxdt of the own value as Jacobian.
+     *
+     * @tparam TABLEAU Coefficients, e.g. rang_angermann
+     * @tparam CURRENCY The currency (e.g. double)
+     * @tparam ORG_T
+     */
+    template<typename TABLEAU, typename CURRENCY, typename ORG_T>
+    class rosenbrock {
+
+    public:
+        using currency = CURRENCY;
+        using tableau_t = TABLEAU;
+
+        /**
+         * @brief Global number of steps for the Integrator
+         * @details One per stage
+         *
+         */
+        inline static const int steps = TABLEAU::stages;
+
+        /**
+         * @brief Does the last stage give the derivative of the first stage of the next step
+         *
+         */
+        static constexpr bool fsal = false;
+
+        /**
+         * @brief Is there an error estimate for the step size control
+         *
+         */
+        static constexpr bool adaptive = true;
+
+        /**
+         * @brief Do the stage updates solve linear systems with the Jacobian
+         *
+         */
+        static constexpr bool implicit = true;
+
+    private:
+        static constexpr int S = TABLEAU::stages;
+
+        /**
+         * @brief Transformed coefficients
+         * @details With G = gamma_ij + gamma I: a = alpha G^-1, c = diag(1 / gamma) - G^-1,
+         *          m = b G^-1 and e = (b - b_hat) G^-1
+         *
+         */
+        struct coefficients {
+            double a[S][S];
+            double c[S][S];
+            double m[S];
+            double e[S];
+            double t[S];
+
+            constexpr coefficients() : a(), c(), m(), e(), t() {
+                double inv[S][S] = {};
+
+                // inverse of the lower triangular G, column by column
+                for (int j = 0; j < S; ++j) {
+                    inv[j][j] = 1.0 / TABLEAU::gamma;
+                    for (int i = j + 1; i < S; ++i) {
+                        double sum = 0.0;
+                        for (int k = j; k < i; ++k) {
+                            sum += TABLEAU::gamma_ij[i][k] * inv[k][j];
+                        }
+                        inv[i][j] = -sum / TABLEAU::gamma;
+                    }
+                }
+
+                for (int i = 0; i < S; ++i) {
+                    for (int j = 0; j < i; ++j) {
+                        for (int k = j; k < i; ++k) {
+                            this->a[i][j] += TABLEAU::alpha[i][k] * inv[k][j];
+                        }
+                        this->c[i][j] = -inv[i][j];
+                    }
+                    for (int j = 0; j < S; ++j) {
+                        this->m[j] += TABLEAU::b[i] * inv[i][j];
+                        this->e[j] += (TABLEAU::b[i] - TABLEAU::b_hat[i]) * inv[i][j];
+                        this->t[i] += TABLEAU::alpha[i][j];
+                    }
+                }
+            }
+        };
+
+        static constexpr coefficients co{};
+
+        /**
+         * @brief Backreference to the organism
+         *
+         */
+        ORG_T& org;
+
+        /**
+         * @brief Owned store if the integrator is not bound to a shared one
+         *
+         */
+        std::unique_ptr<integrator_store<currency> > own_store;
+
+        /**
+         * @brief Store holding stage values, k values, sums and error
+         * @details The k values hold f of the stage until the solve replaces them by u
+         *
+         */
+        integrator_store<currency>* store;
+
+        /**
+         * @brief Slot of this integrator in the store
+         *
+         */
+        std::size_t idx;
+
+        /**
+         * @brief Count the step number
+         * @details One substep per stage
+         *
+         */
+        int stepnum = 0;
+
+        /**
+         * @brief Derivative of dxdt by the own value, for step()
+         *
+         */
+        currency jac = 0.0;
+
+        currency& x(int n) {
+            return this->store->xs[n][this->idx];
+        }
+
+        currency& k(int n) {
+            return this->store->ks[n][this->idx];
+        }
+
+        /**
+         * @brief Raw stage arrays of a store
+         *
+         */
+        struct stage_view {
+            currency* x[S];
+            currency* k[S];
+            currency* last_dxdt;
+            currency* error;
+
+            explicit stage_view(integrator_store<currency>& s) : last_dxdt(s.last_dxdt.data()), error(s.error.data()) {
+                for (int n = 0; n < S; ++n) {
+                    this->x[n] = s.xs[n].data();
+                    this->k[n] = s.ks[n].data();
+                }
+            }
+        };
+
+        /**
+         * @brief Sum of w[j] * u[j] over the stages J of slot i
+         *
+         * @tparam J
+         * @param w Weights
+         * @param v
+         * @param i
+         * @return currency
+         */
+        template<std::size_t... J>
+        static currency weighted(const double (&w)[S], const stage_view& v, std::size_t i, std::index_sequence<J...>) {
+            currency sum = 0.0;
+            ((w[J] != 0.0 ? sum += w[J] * v.k[J][i] : sum), ...);
+            return sum;
+        }
+
+        /**
+         * @brief Right hand side of stage N of slot i
+         *
+         * @tparam N
+         * @param v
+         * @param i
+         * @param dt
+         */
+        template<int N>
+        static void rhs(const stage_view& v, std::size_t i, double dt) {
+            if constexpr (N > 0) {
+                v.k[N][i] += weighted(co.c[N], v, i, std::make_index_sequence<N>{}) / dt;
+            }
+        }
+
+        /**
+         * @brief Next stage value or the results of the step for slot i
+         *
+         * @tparam N
+         * @param v
+         * @param i
+         * @param dt
+         */
+        template<int N>
+        static void update(const stage_view& v, std::size_t i, double dt) {
+            if constexpr (N < S - 1) {
+                v.x[N + 1][i] = v.x[0][i] + weighted(co.a[N + 1], v, i, std::make_index_sequence<N + 1>{});
+            } else {
+                const currency dx = weighted(co.m, v, i, std::make_index_sequence<S>{});
+                v.error[i] = weighted(co.e, v, i, std::make_index_sequence<S>{});
+                v.last_dxdt[i] = dx / dt;
+                v.x[0][i] = v.x[0][i] + dx;
+            }
+        }
+
+        /**
+         * @brief Stage update of all slots
+         *
+         * @tparam N
+         * @tparam SYSTEM
+         * @param s
+         * @param active
+         * @param dt
+         * @param sys
+         */
+        template<int N, typename SYSTEM>
+        static void stage_update(integrator_store<currency>& s, const char* active, double dt, SYSTEM& sys) {
+            const stage_view v(s);
+            const std::size_t size = s.size();
+
+            if constexpr (N == 0) {
+                sys.factor(1.0 / (TABLEAU::gamma * dt));
+            }
+
+            for (std::size_t i = 0; i < size; ++i) {
+                rhs<N>(v, i, dt);
+            }
+
+            sys.solve(v.k[N]);
+
+            if constexpr (N < S - 1) {
+                for (std::size_t i = 0; i < size; ++i) {
+                    update<N>(v, i, dt);
+                }
+            } else {
+                for (std::size_t i = 0; i < size; ++i) {
+                    if (active[i]) {
+                        update<N>(v, i, dt);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Select stage n at compile time
+         *
+         * @tparam N
+         * @tparam F
+         * @param n
+         * @param f Called with std::integral_constant<int, n>
+         */
+        template<int N, typename F>
+        static void stage_iter(int n, F&& f) {
+            if constexpr (N < S) {
+                if (n == N) {
+                    f(std::integral_constant<int, N>{});
+                } else {
+                    stage_iter<N + 1>(n, f);
+                }
+            }
+        }
+
+    public:
+
+        /**
+         * @brief Error Threshold
+         * @details Absolute tolerance of the error estimate
+         *
+         */
+        inline static currency w_error = 0.1;
+
+        /**
+         * @brief Construct a new integrator with its own store
+         *
+         * @param org
+         */
+        explicit rosenbrock(ORG_T& org) : org(org),
+                                          own_store(std::make_unique<integrator_store<currency> >()),
+                                          store(own_store.get()),
+                                          idx(0) {
+            this->store->reserve_stages(steps);
+            this->idx = this->store->emplace_back();
+        };
+
+        /**
+         * @brief Construct a new integrator as view on a new slot of a shared store
+         *
+         * @tparam STORE Store type derived from integrator_store
+         * @param org
+         * @param store
+         */
+        template <typename STORE>
+        rosenbrock(ORG_T& org, STORE& store) : org(org), store(&store), idx(0) {
+            this->store->reserve_stages(steps);
+            this->idx = store.emplace_back();
+        };
+
+        /**
+         * @brief Get the store
+         *
+         * @return integrator_store<currency>&
+         */
+        integrator_store<currency>& get_store() {
+            return *this->store;
+        }
+
+        /**
+         * @brief Get the slot in the store
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t get_index() const {
+            return this->idx;
+        }
+
+        /**
+         * @brief Move the view to another slot of the store
+         * @details Used when the store is compacted
+         *
+         * @param i
+         */
+        void set_index(std::size_t i) {
+            this->idx = i;
+        }
+
+        /**
+         * @brief Change of the previous step
+         *
+         * @return currency&
+         */
+        currency& get_last_dxdt() {
+            return this->store->last_dxdt[this->idx];
+        }
+
+        /**
+         * @brief Get the value
+         *
+         * @return currency&
+         */
+        currency& get_value() {
+            return this->store->xs[this->stepnum][this->idx];
+        }
+
+        /**
+         * @brief Get the value
+         *
+         * @return const currency&
+         */
+        const currency& get_value() const {
+            return this->store->xs[this->stepnum][this->idx];
+        }
+
+        /**
+         * @brief Get Error
+         *
+         * @return const currency&
+         */
+        const currency& get_error() const {
+            return this->store->error[this->idx];
+        }
+
+        /**
+         * @brief Set the value
+         *
+         * @param val
+         */
+        void set_value(const currency& val) {
+            this->store->xs[this->stepnum][this->idx] = val;
+        }
+
+        /**
+         * @brief Access sum
+         *
+         * @tparam T
+         * @param i
+         * @return currency&
+         */
+        template <typename T>
+        currency& operator[] (const T& i) {
+            static_assert(std::is_integral_v<T>, "i has to be integral");
+            return this->store->sum[i][this->idx];
+        }
+
+        template <typename T>
+        const currency& operator[] (const T& i) const {
+            static_assert(std::is_integral_v<T>, "i has to be integral");
+            return this->store->sum[i][this->idx];
+        }
+
+        /**
+         * @brief Clear the sum
+         *
+         */
+        void clear_sum(){
+            for (auto& s : this->store->sum) {
+                s[this->idx] = 0.0;
+            }
+        }
+
+        /**
+         * @brief Derivative of the current stage
+         * @details Batched stepping, the stage values of all species are then
+         *          updated at once by stage_update()
+         *
+         * @tparam SELF Dynamic type of the organism if known, allows static dispatch of dxdt
+         * @param dt
+         */
+        template <typename SELF = ORG_T>
+        void derive(double dt){
+            SELF& org = static_cast<SELF&>(this->org);
+            this->k(this->stepnum) = org.dxdt(this->x(this->stepnum), co.t[this->stepnum] * dt);
+            this->stepnum = (this->stepnum + 1) % steps;
+        }
+
+        /**
+         * @brief Update the stage values of all active slots of a store
+         * @details Solves the linear system of the stage for all slots after derive()
+         *          was called for every active slot. Inactive slots keep their values.
+         *
+         * @tparam SYSTEM Linear system with factor(shift) for shift * I - J and solve(x), e.g. sparse_jacobian
+         * @param s
+         * @param active Active flag of each slot
+         * @param n Stage
+         * @param dt
+         * @param sys Jacobian of all slots of the store
+         */
+        template <typename SYSTEM>
+        static void stage_update(integrator_store<currency>& s, const char* active, int n, double dt, SYSTEM& sys) {
+            stage_iter<0>(n, [&](auto stage){ stage_update<decltype(stage)::value>(s, active, dt, sys); });
+        }
+
+        /**
+         * @brief Step
+         * @details Iterate over steps by calling step() 'steps' times. The first stage
+         *          evaluates dxdt once more for the Jacobian, so the organism must not
+         *          depend on sums.
+         *
+         * @tparam SELF Dynamic type of the organism if known, allows static dispatch of dxdt
+         * @param dt
+         */
+        template <typename SELF = ORG_T>
+        void step(double dt){
+            const int n = this->stepnum;
+            this->template derive<SELF>(dt);
+
+            if (n == 0) {
+                SELF& org = static_cast<SELF&>(this->org);
+                const currency x0 = this->x(0);
+                const currency h = std::sqrt(std::numeric_limits<currency>::epsilon()) * std::max(std::fabs(x0), currency(1.0));
+                this->jac = (org.dxdt(x0 + h, 0.0) - this->k(0)) / h;
+            }
+
+            stage_iter<0>(n, [&](auto stage){
+                constexpr int N = decltype(stage)::value;
+                const stage_view v(*this->store);
+                rhs<N>(v, this->idx, dt);
+                v.k[N][this->idx] /= 1.0 / (TABLEAU::gamma * dt) - this->jac;
+                update<N>(v, this->idx, dt);
+            });
+        }
+
+        /**
+         * @brief resize sum vector
+         *
+         * @param size
+         */
+        void resize(const int& size){
+            this->store->reserve_sums(size);
+        }
+
+        /**
+         * @brief Calculate new step size individual level
+         * @details The error norm is taken over the whole store in calc_new_step_size()
+         *
+         * @param dt
+         * @param new_dt
+         */
+        virtual void calc_new_step_size_s(double /*dt*/, double& /*new_dt*/) {
+
+        }
+
+        /**
+         * @brief Calculate new step size on global level
+         * @details See explicit_rk::calc_new_step_size()
+         *
+         * @param s
+         * @param active Slots in the norm
+         * @param dt
+         * @param new_dt Smallest proposal of calc_new_step_size_s(), replaced by the step size of the controller
+         * @param controller
+         * @return bool Step accepted
+         */
+        static bool calc_new_step_size(const integrator_store<currency>& s, const char* active, double dt, double& new_dt, step_controller& controller) {
+            double err = controller.error_norm(s, active, w_error, dt);
+
+            // a singular matrix leaves non-finite values, the step is repeated
+            // with a smaller one
+            const currency* x = s.xs[0].data();
+            for (std::size_t i = 0; i < s.size(); ++i) {
+                if (active[i] && !std::isfinite(x[i])) {
+                    err = std::numeric_limits<double>::quiet_NaN();
+                    break;
+                }
+            }
+
+            double proposal;
+            const bool accept = controller.propose(err, dt, TABLEAU::embedded_order + 1, proposal);
+
+            new_dt = accept ? std::min(new_dt, proposal) : proposal;
+
+            return accept;
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_INTEGRATORS_ROSENBROCK
@@ -0,0 +1,556 @@
+#ifndef UTOPIA_MODELS_INTEGRATORS_SPARSE_JACOBIAN
+#define UTOPIA_MODELS_INTEGRATORS_SPARSE_JACOBIAN
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Sparse LU Factorization
+     * @details LU of a square matrix with a symmetric pattern in compressed sparse rows,
+     *          without pivoting. The rows are reordered by reverse Cuthill-McKee to
+     *          limit the fill in. analyze() computes ordering and fill once per pattern,
+     *          factor() only the values.
+     *
+     * @tparam CURRENCY
+     */
+    template <typename CURRENCY>
+    class sparse_lu {
+    public:
+        using currency = CURRENCY;
+
+    private:
+
+        std::size_t n = 0;
+
+        /**
+         * @brief Old index of new row r and new index of old row i
+         *
+         */
+        std::vector<std::size_t> perm;
+        std::vector<std::size_t> iperm;
+
+        /**
+         * @brief Pattern of L + U in the new order
+         * @details Sorted columns, L has an implicit unit diagonal
+         *
+         */
+        std::vector<std::size_t> row;
+        std::vector<std::size_t> col;
+        std::vector<std::size_t> diag;
+
+        /**
+         * @brief Position of every entry of the matrix in the factors
+         *
+         */
+        std::vector<std::size_t> position;
+
+        std::vector<currency> lu;
+
+        mutable std::vector<currency> work;
+
+        /**
+         * @brief Reverse Cuthill-McKee order of all components
+         *
+         * @param row_ptr
+         * @param cols
+         */
+        void order(const std::vector<std::size_t>& row_ptr, const std::vector<std::size_t>& cols) {
+
+            auto degree = [&](std::size_t i) { return row_ptr[i + 1] - row_ptr[i]; };
+
+            std::vector<std::size_t> by_degree(this->n);
+            std::iota(by_degree.begin(), by_degree.end(), 0);
+            std::stable_sort(by_degree.begin(), by_degree.end(),
+                             [&](std::size_t a, std::size_t b){ return degree(a) < degree(b); });
+
+            std::vector<char> seen(this->n, false);
+            std::vector<std::size_t> next;
+
+            this->perm.clear();
+            this->perm.reserve(this->n);
+
+            for (auto start : by_degree) {
+                if (seen[start]) {
+                    continue;
+                }
+                seen[start] = true;
+                this->perm.push_back(start);
+
+                for (std::size_t q = this->perm.size() - 1; q < this->perm.size(); ++q) {
+                    const std::size_t i = this->perm[q];
+
+                    next.clear();
+                    for (std::size_t k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+                        if (!seen[cols[k]]) {
+                            seen[cols[k]] = true;
+                            next.push_back(cols[k]);
+                        }
+                    }
+                    std::stable_sort(next.begin(), next.end(),
+                                     [&](std::size_t a, std::size_t b){ return degree(a) < degree(b); });
+                    this->perm.insert(this->perm.end(), next.begin(), next.end());
+                }
+            }
+
+            std::reverse(this->perm.begin(), this->perm.end());
+
+            this->iperm.assign(this->n, 0);
+            for (std::size_t r = 0; r < this->n; ++r) {
+                this->iperm[this->perm[r]] = r;
+            }
+        }
+
+    public:
+
+        /**
+         * @brief Number of rows
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t size() const {
+            return this->n;
+        }
+
+        /**
+         * @brief Number of entries of L + U
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t fill() const {
+            return this->col.size();
+        }
+
+        /**
+         * @brief Ordering and pattern of the factors
+         *
+         * @param size Number of rows
+         * @param row_ptr Row offsets of the matrix
+         * @param cols Sorted columns of every row, including the diagonal
+         */
+        void analyze(std::size_t size, const std::vector<std::size_t>& row_ptr, const std::vector<std::size_t>& cols) {
+
+            this->n = size;
+            this->order(row_ptr, cols);
+
+            this->row.assign(1, 0);
+            this->col.clear();
+            this->diag.assign(this->n, 0);
+
+            // rows in the new order, the fill of row r comes from the U rows k < r
+            // in its pattern, taken in ascending order as they add columns k' > k
+            std::vector<char> mark(this->n, false);
+            std::vector<std::size_t> pattern;
+            std::vector<std::size_t> lower;
+
+            for (std::size_t r = 0; r < this->n; ++r) {
+                const std::size_t i = this->perm[r];
+
+                pattern.clear();
+                lower.clear();
+
+                auto add = [&](std::size_t c) {
+                    if (mark[c]) {
+                        return;
+                    }
+                    mark[c] = true;
+                    pattern.push_back(c);
+                    if (c < r) {
+                        lower.push_back(c);
+                        std::push_heap(lower.begin(), lower.end(), std::greater<>());
+                    }
+                };
+
+                for (std::size_t k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+                    add(this->iperm[cols[k]]);
+                }
+
+                while (!lower.empty()) {
+                    std::pop_heap(lower.begin(), lower.end(), std::greater<>());
+                    const std::size_t k = lower.back();
+                    lower.pop_back();
+
+                    for (std::size_t p = this->diag[k] + 1; p < this->row[k + 1]; ++p) {
+                        add(this->col[p]);
+                    }
+                }
+
+                std::sort(pattern.begin(), pattern.end());
+
+                for (auto c : pattern) {
+                    if (c == r) {
+                        this->diag[r] = this->col.size();
+                    }
+                    this->col.push_back(c);
+                    mark[c] = false;
+                }
+
+                this->row.push_back(this->col.size());
+            }
+
+            // where the entries of the matrix go
+            this->position.assign(cols.size(), 0);
+            for (std::size_t i = 0; i < this->n; ++i) {
+                const std::size_t r = this->iperm[i];
+                for (std::size_t k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+                    auto it = std::lower_bound(this->col.begin() + this->row[r], this->col.begin() + this->row[r + 1], this->iperm[cols[k]]);
+                    this->position[k] = std::size_t(it - this->col.begin());
+                }
+            }
+
+            this->lu.assign(this->col.size(), 0.0);
+            this->work.assign(this->n, 0.0);
+        }
+
+        /**
+         * @brief Factorize a matrix with the pattern given to analyze()
+         * @details A zero pivot shows up as inf or NaN in the solution
+         *
+         * @param values Entries in the order of the pattern
+         */
+        void factor(const currency* values) {
+
+            std::fill(this->lu.begin(), this->lu.end(), 0.0);
+            for (std::size_t k = 0; k < this->position.size(); ++k) {
+                this->lu[this->position[k]] = values[k];
+            }
+
+            std::vector<currency>& w = this->work;
+
+            for (std::size_t r = 0; r < this->n; ++r) {
+
+                for (std::size_t p = this->row[r]; p < this->row[r + 1]; ++p) {
+                    w[this->col[p]] = this->lu[p];
+                }
+
+                for (std::size_t p = this->row[r]; p < this->diag[r]; ++p) {
+                    const std::size_t k = this->col[p];
+                    const currency l = w[k] / this->lu[this->diag[k]];
+                    w[k] = l;
+                    for (std::size_t q = this->diag[k] + 1; q < this->row[k + 1]; ++q) {
+                        w[this->col[q]] -= l * this->lu[q];
+                    }
+                }
+
+                for (std::size_t p = this->row[r]; p < this->row[r + 1]; ++p) {
+                    this->lu[p] = w[this->col[p]];
+                }
+            }
+        }
+
+        /**
+         * @brief Solve in place
+         *
+         * @param x Right hand side, overwritten by the solution
+         */
+        void solve(currency* x) const {
+
+            std::vector<currency>& y = this->work;
+
+            for (std::size_t r = 0; r < this->n; ++r) {
+                currency v = x[this->perm[r]];
+                for (std::size_t p = this->row[r]; p < this->diag[r]; ++p) {
+                    v -= this->lu[p] * y[this->col[p]];
+                }
+                y[r] = v;
+            }
+
+            for (std::size_t r = this->n; r-- > 0;) {
+                currency v = y[r];
+                for (std::size_t p = this->diag[r] + 1; p < this->row[r + 1]; ++p) {
+                    v -= this->lu[p] * y[this->col[p]];
+                }
+                y[r] = v / this->lu[this->diag[r]];
+            }
+
+            for (std::size_t r = 0; r < this->n; ++r) {
+                x[this->perm[r]] = y[r];
+            }
+        }
+
+    };
+
+    /**
+     * @brief Sparse Jacobian of a Community
+     * @details Jacobian J of the derivatives of all slots of a species store, with
+     *          the pattern of the interaction graph, and the LU factors of
+     *          shift * I - J for the linear systems of implicit integrators.
+     *          The factors are kept while J and the shift do not change.
+     *
+     *          The columns are colored such that no row depends on two columns of
+     *          the same color, one evaluation per color gives the finite differences.
+     *
+     * @tparam CURRENCY
+     */
+    template <typename CURRENCY>
+    class sparse_jacobian {
+    public:
+        using currency = CURRENCY;
+
+        /**
+         * @brief No color, for slots outside of the Jacobian
+         *
+         */
+        static constexpr std::size_t no_color = std::numeric_limits<std::size_t>::max();
+
+    private:
+
+        std::size_t n = 0;
+
+        /**
+         * @brief Pattern in compressed sparse rows, sorted columns with diagonal
+         *
+         */
+        std::vector<std::size_t> row;
+        std::vector<std::size_t> col;
+
+        /**
+         * @brief Position of the transposed entry
+         *
+         */
+        std::vector<std::size_t> transposed;
+
+        std::vector<std::size_t> diag;
+
+        /**
+         * @brief Entries of J
+         *
+         */
+        std::vector<currency> values;
+
+        /**
+         * @brief Slots of every color
+         *
+         */
+        std::vector<std::vector<std::size_t> > colors;
+
+        sparse_lu<currency> lu;
+
+        /**
+         * @brief Entries of shift * I - J
+         *
+         */
+        std::vector<currency> matrix;
+
+        double shift = std::numeric_limits<double>::quiet_NaN();
+        bool factored = false;
+
+    public:
+
+        /**
+         * @brief Versions the pattern was built for
+         * @details Topology version and active version of the species store
+         *
+         */
+        std::pair<std::size_t, std::size_t> version = {std::numeric_limits<std::size_t>::max(), 0};
+
+        /**
+         * @brief Accepted steps since J was evaluated
+         *
+         */
+        std::size_t age = std::numeric_limits<std::size_t>::max();
+
+        /**
+         * @brief Number of evaluations of J
+         *
+         */
+        std::size_t evaluations = 0;
+
+        /**
+         * @brief Number of numeric factorizations
+         *
+         */
+        std::size_t factorizations = 0;
+
+        /**
+         * @brief Number of slots
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t size() const {
+            return this->n;
+        }
+
+        /**
+         * @brief Number of colors
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t n_colors() const {
+            return this->colors.size();
+        }
+
+        /**
+         * @brief Slots of color c
+         *
+         * @param c
+         * @return const std::vector<std::size_t>&
+         */
+        [[nodiscard]] const std::vector<std::size_t>& color(std::size_t c) const {
+            return this->colors[c];
+        }
+
+        /**
+         * @brief Set the pattern
+         * @details Dependent slots in both directions. Every slot gets a diagonal entry,
+         *          slots without a color (e.g. inactive ones) have only that one.
+         *
+         * @param size Number of slots
+         * @param pairs Slot pairs (i, j) where the derivative of i depends on j or vice versa
+         * @param in_color Slots that get a color
+         */
+        void set_pattern(std::size_t size, const std::vector<std::pair<std::size_t, std::size_t> >& pairs, const std::vector<char>& in_color) {
+
+            this->n = size;
+
+            std::vector<std::vector<std::size_t> > rows(size);
+            for (std::size_t i = 0; i < size; ++i) {
+                rows[i].push_back(i);
+            }
+            for (const auto& [i, j] : pairs) {
+                rows[i].push_back(j);
+                rows[j].push_back(i);
+            }
+
+            this->row.assign(1, 0);
+            this->col.clear();
+            this->diag.assign(size, 0);
+            for (std::size_t i = 0; i < size; ++i) {
+                std::sort(rows[i].begin(), rows[i].end());
+                rows[i].erase(std::unique(rows[i].begin(), rows[i].end()), rows[i].end());
+                for (auto j : rows[i]) {
+                    if (j == i) {
+                        this->diag[i] = this->col.size();
+                    }
+                    this->col.push_back(j);
+                }
+                this->row.push_back(this->col.size());
+            }
+
+            this->transposed.assign(this->col.size(), 0);
+            for (std::size_t i = 0; i < size; ++i) {
+                for (std::size_t k = this->row[i]; k < this->row[i + 1]; ++k) {
+                    const std::size_t j = this->col[k];
+                    auto it = std::lower_bound(this->col.begin() + this->row[j], this->col.begin() + this->row[j + 1], i);
+                    this->transposed[k] = std::size_t(it - this->col.begin());
+                }
+            }
+
+            // greedy distance-2 coloring, columns of one color share no row
+            std::vector<std::size_t> color_of(size, no_color);
+            std::vector<std::size_t> forbidden;
+            this->colors.clear();
+
+            for (std::size_t j = 0; j < size; ++j) {
+                if (!in_color[j]) {
+                    continue;
+                }
+                for (std::size_t k = this->row[j]; k < this->row[j + 1]; ++k) {
+                    const std::size_t i = this->col[k];
+                    for (std::size_t q = this->row[i]; q < this->row[i + 1]; ++q) {
+                        const std::size_t c = color_of[this->col[q]];
+                        if (c != no_color) {
+                            forbidden.push_back(c);
+                        }
+                    }
+                }
+                std::sort(forbidden.begin(), forbidden.end());
+                forbidden.erase(std::unique(forbidden.begin(), forbidden.end()), forbidden.end());
+
+                std::size_t c = 0;
+                while (c < forbidden.size() && forbidden[c] == c) {
+                    ++c;
+                }
+                forbidden.clear();
+
+                color_of[j] = c;
+                if (c == this->colors.size()) {
+                    this->colors.emplace_back();
+                }
+                this->colors[c].push_back(j);
+            }
+
+            this->values.assign(this->col.size(), 0.0);
+            this->matrix.assign(this->col.size(), 0.0);
+            this->lu.analyze(size, this->row, this->col);
+
+            this->factored = false;
+            this->age = std::numeric_limits<std::size_t>::max();
+        }
+
+        /**
+         * @brief Set column j from finite differences
+         * @details Rows outside the pattern of column j are ignored
+         *
+         * @param j
+         * @param f0 Derivatives at the unperturbed values
+         * @param f1 Derivatives with slot j perturbed by h
+         * @param h
+         */
+        void set_column(std::size_t j, const currency* f0, const currency* f1, currency h) {
+            for (std::size_t k = this->row[j]; k < this->row[j + 1]; ++k) {
+                const std::size_t i = this->col[k];
+                this->values[this->transposed[k]] = (f1[i] - f0[i]) / h;
+            }
+            this->factored = false;
+        }
+
+        /**
+         * @brief Entry (i, j), zero outside the pattern
+         *
+         * @param i
+         * @param j
+         * @return currency
+         */
+        [[nodiscard]] currency operator()(std::size_t i, std::size_t j) const {
+            auto begin = this->col.begin() + this->row[i];
+            auto end = this->col.begin() + this->row[i + 1];
+            auto it = std::lower_bound(begin, end, j);
+            return it != end && *it == j ? this->values[std::size_t(it - this->col.begin())] : currency(0.0);
+        }
+
+        /**
+         * @brief Factorize shift * I - J
+         * @details Nothing to do if neither J nor the shift changed since the last call
+         *
+         * @param s
+         */
+        void factor(double s) {
+            if (this->factored && s == this->shift) {
+                return;
+            }
+
+            for (std::size_t k = 0; k < this->col.size(); ++k) {
+                this->matrix[k] = -this->values[k];
+            }
+            for (std::size_t i = 0; i < this->n; ++i) {
+                this->matrix[this->diag[i]] += s;
+            }
+
+            this->lu.factor(this->matrix.data());
+
+            this->shift = s;
+            this->factored = true;
+            ++this->factorizations;
+        }
+
+        /**
+         * @brief Solve (shift * I - J) x = b in place
+         *
+         * @param x b, overwritten by x
+         */
+        void solve(currency* x) const {
+            this->lu.solve(x);
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_INTEGRATORS_SPARSE_JACOBIAN
@@ -0,0 +1,243 @@
+#ifndef UTOPIA_MODELS_INTEGRATORS_STEP_CONTROLLER
+#define UTOPIA_MODELS_INTEGRATORS_STEP_CONTROLLER
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include "integrator_store.hh"
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Step Size Controller
+     * @details Decides whether a step of an adaptive integrator is accepted and
+     *          proposes the next step size from the error norm err of the step
+     *          (err <= 1 is within the tolerance). The integrators take the max or
+     *          RMS norm over the species, with the absolute tolerance of the
+     *          integrator and the relative tolerance rtol.
+     *
+     *          integral:   fac = safety * err^(-1/k)
+     *          pi:         fac = safety * err^(-0.7/k) * err_old^(0.4/k)
+     *          gustafsson: fac = min(integral, safety * dt / dt_old * (err_old / err^2)^(1/k))
+     *
+     *          with k the order of the embedded method + 1 and err_old, dt_old of
+     *          the last accepted step. After a rejection the step does not grow.
+     *          Steps of at most min_dt are always accepted. Steps with a non-finite
+     *          error are rejected and shrink by min_factor.
+     *
+     */
+    class step_controller {
+    public:
+
+        enum class type_t { integral, pi, gustafsson };
+
+        enum class norm_t { max, rms };
+
+        /**
+         * @brief Controller type
+         *
+         */
+        type_t type = type_t::integral;
+
+        /**
+         * @brief Norm of the errors of all species
+         *
+         */
+        norm_t norm = norm_t::max;
+
+        /**
+         * @brief Relative tolerance
+         *
+         */
+        double rtol = 0.0;
+
+        /**
+         * @brief Safety factor
+         *
+         */
+        double safety = 0.95;
+
+        /**
+         * @brief Smallest factor by which a step can shrink
+         *
+         */
+        double min_factor = 0.2;
+
+        /**
+         * @brief Largest factor by which a step can grow
+         *
+         */
+        double max_factor = 5.0;
+
+        /**
+         * @brief Steps of at most min_dt are never rejected
+         *
+         */
+        double min_dt = 0.0;
+
+    private:
+
+        double err_old = 1.0;
+        double dt_old = 0.0;
+        bool has_history = false;
+        bool rejected = false;
+
+        /**
+         * @brief Number of rejected steps
+         *
+         */
+        std::size_t rejections = 0;
+
+    public:
+
+        /**
+         * @brief Parse a controller type
+         *
+         * @param name integral, pi or gustafsson
+         * @return type_t
+         */
+        static type_t type_of(const std::string& name) {
+            if (name == "integral") {
+                return type_t::integral;
+            } else if (name == "pi") {
+                return type_t::pi;
+            } else if (name == "gustafsson") {
+                return type_t::gustafsson;
+            }
+            throw std::invalid_argument("No valid step controller '" + name + "'. Use integral, pi or gustafsson.");
+        }
+
+        /**
+         * @brief Parse a norm
+         *
+         * @param name max or rms
+         * @return norm_t
+         */
+        static norm_t norm_of(const std::string& name) {
+            if (name == "max") {
+                return norm_t::max;
+            } else if (name == "rms") {
+                return norm_t::rms;
+            }
+            throw std::invalid_argument("No valid error norm '" + name + "'. Use max or rms.");
+        }
+
+        /**
+         * @brief Error norm of a step over the active slots of a store
+         * @details Each error relative to atol + rtol * max(|x_old|, |x_new|), where
+         *          the old value is the new one minus the change of the step. NaN is kept.
+         *
+         * @tparam CURRENCY
+         * @param s Store after the last stage
+         * @param active Slots in the norm
+         * @param atol Absolute tolerance
+         * @param dt
+         * @return double
+         */
+        template <typename CURRENCY>
+        [[nodiscard]] double error_norm(const integrator_store<CURRENCY>& s, const char* active, double atol, double dt) const {
+            const std::size_t size = s.size();
+            const CURRENCY* x = s.xs[0].data();
+            const CURRENCY* last_dxdt = s.last_dxdt.data();
+            const CURRENCY* error = s.error.data();
+            const double rtol = this->rtol;
+
+            auto scaled = [&](std::size_t i) {
+                const CURRENCY scale = atol + rtol * std::max(std::fabs(x[i]), std::fabs(x[i] - last_dxdt[i] * dt));
+                return active[i] ? std::fabs(error[i]) / scale : CURRENCY(0.0);
+            };
+
+            CURRENCY err = 0.0;
+
+            if (this->norm == norm_t::rms) {
+                std::size_t n = 0;
+                for (std::size_t i = 0; i < size; ++i) {
+                    const CURRENCY q = scaled(i);
+                    err += q * q;
+                    n += active[i] ? 1 : 0;
+                }
+                return n > 0 ? std::sqrt(err / CURRENCY(n)) : 0.0;
+            }
+
+            // std::max would drop NaN
+            for (std::size_t i = 0; i < size; ++i) {
+                const CURRENCY q = scaled(i);
+                err = q > err || std::isnan(q) ? q : err;
+            }
+            return err;
+        }
+
+        /**
+         * @brief Forget the previous steps
+         *
+         */
+        void reset() {
+            this->err_old = 1.0;
+            this->dt_old = 0.0;
+            this->has_history = false;
+            this->rejected = false;
+        }
+
+        /**
+         * @brief Number of rejected steps so far
+         *
+         * @return std::size_t
+         */
+        [[nodiscard]] std::size_t get_rejections() const {
+            return this->rejections;
+        }
+
+        /**
+         * @brief Accept or reject a step and propose the next step size
+         *
+         * @param err Error norm of the step
+         * @param dt Size of the step
+         * @param k Order of the embedded method + 1
+         * @param new_dt Next step size, or the size for the repetition if rejected
+         * @return bool Accepted
+         */
+        bool propose(double err, double dt, int k, double& new_dt) {
+
+            const bool accept = err <= 1.0 || dt <= this->min_dt;
+
+            double fac = this->max_factor;
+
+            if (!std::isfinite(err)) {
+                // the step left the range of the model
+                fac = this->min_factor;
+            } else if (err > 0.0) {
+                fac = this->safety * std::pow(err, -1.0 / k);
+
+                if (accept && this->has_history && this->type == type_t::pi) {
+                    fac = this->safety * std::pow(err, -0.7 / k) * std::pow(this->err_old, 0.4 / k);
+                } else if (accept && this->has_history && this->type == type_t::gustafsson) {
+                    fac = std::min(fac, this->safety * dt / this->dt_old * std::pow(this->err_old / (err * err), 1.0 / k));
+                }
+            }
+
+            fac = std::clamp(fac, this->min_factor, this->rejected ? 1.0 : this->max_factor);
+
+            if (accept) {
+                // a vanishing error would stop the PI terms from ever recovering
+                this->err_old = std::isfinite(err) ? std::max(err, 1e-4) : 1.0;
+                this->dt_old = dt;
+                this->has_history = true;
+                this->rejected = false;
+            } else {
+                this->rejected = true;
+                ++this->rejections;
+            }
+
+            new_dt = std::max(dt * fac, this->min_dt);
+
+            return accept;
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif //UTOPIA_MODELS_INTEGRATORS_STEP_CONTROLLER
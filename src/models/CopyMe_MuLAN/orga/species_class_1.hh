@@ -17,12 +17,13 @@ namespace MuLAN_MA {
     // Inherit from MuLAN organism
     // TODO: change name
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
-    class species_class_1: public organism<DOM_T, PSPACE_T>{
+    class species_class_1 final : public organism<DOM_T, PSPACE_T>{
 
     public:
 
         using pp_ptr [[maybe_unused]] = boost::shared_ptr<species_class_1>;
         using org_ptr = typename organism<DOM_T, PSPACE_T>::org_ptr;
+        using org_t = typename organism<DOM_T, PSPACE_T>::org_t;
         using currency = typename DOM_T::integrator_t::currency;
 
         // TODO: get compile time parameters from pack
@@ -38,6 +39,17 @@ namespace MuLAN_MA {
         // TODO: give it a layer id
         const static int type_id = 0;
 
+        // TODO: restrict to the types calc_interaction_coeff can return non-zero values for
+        static constexpr bool interacts_with(int /*type*/) {
+            return true;
+        }
+
+        // TODO: set if the lower sums of this class only come from its own out edges
+        static constexpr bool fused_sums = false;
+
+        // TODO: set if additionally no other class has edges into this one
+        static constexpr bool fused_stage = false;
+
         // Store number of species
         static int spec_count;
 
@@ -74,22 +86,57 @@ namespace MuLAN_MA {
          * @param org2  Organism
          * @return
          */
-        typename DOM_T::edge_cont calc_interaction_coeff(const org_ptr org2) const override {
+        typename DOM_T::edge_cont calc_interaction_coeff(const org_t& org2) const override {
 
             // TODO: calculate interaction edge
             return typename DOM_T::edge_cont{0.0};
         }
 
+        /**
+         * @brief Precompute constants derived from the parameters (optional)
+         * @details Called when the species is created and whenever its parameters change
+         *
+         */
+        void update_constants() override {
+
+            // TODO: cache values of this->parameters used by calc_interaction_coeff and dxdt
+        }
+
+        /**
+         * @brief Interaction radius in trait space (optional)
+         * @details Bound on the trait[0] distance to organisms of the given type that
+         *          can get an edge, negative if none can. Bounds the edge search.
+         *
+         * @param tolerance Interaction tolerance
+         * @param type Type of the other organism
+         * @return double
+         */
+        [[nodiscard]] double interaction_radius(double tolerance, int type) const override {
+
+            // TODO: derive from calc_interaction_coeff, unbounded otherwise
+            return organism<DOM_T, PSPACE_T>::interaction_radius(tolerance, type);
+        }
+
+
+        void add_own_cont1(const typename DOM_T::edge_cont& val, org_t& organism_2) override {
 
-        void add_edge_cont1(const typename DOM_T::edge_cont& val, org_ptr organism_2) override {
+            // TODO: calculate most inner sums of this organism
+
+        }
+
+        void add_own_cont2(const typename DOM_T::edge_cont& /*val*/, org_t& /*organism_2*/) override {
+
+            // TODO: calculate second most inner sums of this organism
+        }
 
-            // TODO: calculate most inner sums
+        void add_partner_cont1(const typename DOM_T::edge_cont& /*val*/, org_t& /*organism_2*/) override {
 
+            // TODO: calculate most inner sums of organism_2 (only write to organism_2)
         }
 
-        void add_edge_cont2(const typename DOM_T::edge_cont& /*val*/, const org_ptr /*organism_2*/) override {
+        void add_partner_cont2(const typename DOM_T::edge_cont& /*val*/, org_t& /*organism_2*/) override {
 
-            // TODO: calculate second most inner sums
+            // TODO: calculate second most inner sums of organism_2 (only write to organism_2)
         }
 
         // void set_parameters();
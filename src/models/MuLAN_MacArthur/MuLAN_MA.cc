@@ -45,7 +45,11 @@ int main (int /*argc*/, char** argv)
         const cfg_map config_map {
             {"integrator", {
                     {"rkck", 0},
-                    {"euler", 1}
+                    {"euler", 1},
+                    {"dopri5", 2},
+                    {"bs32", 3},
+                    {"rk4", 4},
+                    {"ros34pw2", 5}
                 }
             },
             {"step_func", {
@@ -75,7 +79,7 @@ int main (int /*argc*/, char** argv)
 
         /// Run the Model with Run::run() config from pp
         /// integers behind the runner class denote the number of config parameters
-        Builder.build<Run<double>, 2,2,3,4>(pp);
+        Builder.build<Run<double>, 6,2,3,4>(pp);
 
         return 0;
     }
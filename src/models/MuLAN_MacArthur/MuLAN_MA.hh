@@ -16,6 +16,7 @@
 #include <functional>
 
 #include "domain.hh"
+#include "lattice_sums.hh"
 #include "utils/MuLAN_MA_utils.hh"
 #include "utils/Organism_Factory.hh"
 #include "utils/Organism_Manager.hh"
@@ -158,6 +159,31 @@ namespace Utopia::Models::MuLAN_MA {
          */
         double _min_dt = 0.0;
 
+        /**
+         * @brief Remove extinct species every n mutation intervals
+         * @details 0 disables the periodic compaction
+         *
+         */
+        int _compaction_interval = 0;
+
+        /**
+         * @brief Remove extinct species if their fraction exceeds this value
+         *
+         */
+        double _compaction_dead_fraction = 1.0;
+
+        /**
+         * @brief Minimal time since extinction before a species is removed
+         *
+         */
+        double _compaction_min_age = 0.0;
+
+        /**
+         * @brief Mutation intervals since the last compaction
+         *
+         */
+        int _intervals_since_compaction = 0;
+
         /**
          * @brief Which Traits are mutable
          * @details Entry i corresponds to trait entry i
@@ -226,15 +252,67 @@ namespace Utopia::Models::MuLAN_MA {
                 this->_min_dt = get_as<double>("min_dt", this->_cfg);
             }
 
+            step_controller controller;
+            if (this->_cfg["step_control"]) {
+                auto cfg_control = this->_cfg["step_control"];
+                controller.type = step_controller::type_of(get_as<std::string>("controller", cfg_control));
+                controller.safety = get_as<double>("safety", cfg_control);
+                controller.min_factor = get_as<double>("min_factor", cfg_control);
+                controller.max_factor = get_as<double>("max_factor", cfg_control);
+                if (cfg_control["norm"]) {
+                    controller.norm = step_controller::norm_of(get_as<std::string>("norm", cfg_control));
+                }
+                if (cfg_control["rtol"]) {
+                    controller.rtol = get_as<double>("rtol", cfg_control);
+                }
+            }
+            controller.min_dt = this->_min_dt;
+            this->_dom.set_step_controller(controller);
+
+            if (this->_cfg["compaction"]) {
+                auto cfg_compaction = this->_cfg["compaction"];
+                this->_compaction_interval = get_as<int>("interval", cfg_compaction);
+                this->_compaction_dead_fraction = get_as<double>("dead_fraction", cfg_compaction);
+                this->_compaction_min_age = get_as<double>("min_age", cfg_compaction);
+                if (cfg_compaction["block_layout"]) {
+                    this->_dom.set_block_layout(get_as<bool>("block_layout", cfg_compaction));
+                }
+            }
+
             // TODO: fix for adaptive step
             this->_dom.bsize = get_as<int>("delay", this->_cfg);
 
+            if constexpr (DOM_T::integrator_t::implicit) {
+                // the Jacobian evaluations would push into the delay buffer
+                if (this->_dom.bsize > 0) {
+                    throw std::invalid_argument("Implicit integrators need 'delay: 0'.");
+                }
+                if (this->_cfg["jacobian_interval"]) {
+                    this->_dom.set_jacobian_interval(get_as<std::size_t>("jacobian_interval", this->_cfg));
+                }
+            }
+
             // Set interaction tolerance
             this->_dom.set_interaction_tolerance(get_as<double>("interaction_tolerance", this->_cfg));
 
             // Set Biomass threshold
             this->_dom.set_bm_threshold(get_as<double>("bm_threshold", this->_cfg));
 
+            // Threads for the edge construction
+            if (this->_cfg["threads"]) {
+                this->_dom.set_threads(get_as<std::size_t>("threads", this->_cfg));
+            }
+
+            // Every species collects its own sums (can use the threads)
+            if (this->_cfg["gather_sums"]) {
+                this->_dom.set_gather_sums(get_as<bool>("gather_sums", this->_cfg));
+            }
+
+            // Sum, derivative and update in one sweep for classes that allow it
+            if (this->_cfg["fused_stages"]) {
+                this->_dom.set_fused_stages(get_as<bool>("fused_stages", this->_cfg));
+            }
+
             std::vector<int> producer_conf_v;
 
             // Interaction between producers
@@ -265,6 +343,37 @@ namespace Utopia::Models::MuLAN_MA {
             // Register the consumer type
             this->Add_Consumer = this->_org_mngr.template register_<consumer_t, 5>(consumer_conf_v);
             this->cons_spec_count = &this->Add_Consumer->get_spec_count();
+
+            // Producer and consumer sums by FFT convolution on the trait lattice
+            if (this->_cfg["lattice_sums"] && get_as<bool>("lattice_sums", this->_cfg)) {
+#ifdef MULAN_USE_FFTW
+                double spacing = 1.0;
+                if (this->_cfg["lattice_spacing"]) {
+                    spacing = get_as<double>("lattice_spacing", this->_cfg);
+                }
+
+                const int ppi = producer_conf_v[0];
+                const int resp = consumer_conf_v[0];
+
+                if (resp == 1 && ppi == 0) {
+                    this->template set_lattice_sums<0, 1>(spacing);
+                } else if (resp == 1) {
+                    this->template set_lattice_sums<1, 1>(spacing);
+                } else if (resp == 3 && ppi == 0) {
+                    this->template set_lattice_sums<0, 3>(spacing);
+                } else if (resp == 3) {
+                    this->template set_lattice_sums<1, 3>(spacing);
+                } else if (resp == 4 && ppi == 0) {
+                    this->template set_lattice_sums<0, 4>(spacing);
+                } else if (resp == 4) {
+                    this->template set_lattice_sums<1, 4>(spacing);
+                } else {
+                    throw std::invalid_argument("'lattice_sums' needs a linear, type_2 or type_3 response_func.");
+                }
+#else
+                throw std::invalid_argument("'lattice_sums' needs FFTW. Configure with -DMULAN_USE_FFTW=ON.");
+#endif
+            }
             
             // set mutation on/off
             this->mutate = get_as<std::array<bool, number_species>>("mutation", this->_cfg);
@@ -319,12 +428,31 @@ namespace Utopia::Models::MuLAN_MA {
 
         }
 
+#ifdef MULAN_USE_FFTW
+        /**
+         * @brief Use the lattice sums for the registered producer and consumer
+         *
+         * @tparam PPI Producer interaction
+         * @tparam RESP Response function
+         * @param spacing Lattice spacing
+         */
+        template <int PPI, int RESP>
+        void set_lattice_sums(double spacing) {
+            this->_dom.set_sum_engine(std::make_unique<lattice_sums<typename DOM_T::base_t,
+                                                                    primary_producer_t<PPI>,
+                                                                    consumer_t<RESP> > >(spacing));
+        }
+#endif
+
         void initialize_pp() {
             double pp_trait = 0;
             double pp_init_mass = get_as<double>("pp_init_mass",  this->_cfg);
             std::vector<double> pp_params = {get_as<double>("r", this->_cfg), this->_dom.S(pp_trait, 0.0)};
             // this->_dom.template add_<primary_producer>(pp_init_mass, {0, {pp_trait, 0}, pp_params});
 
+            // build the edges of all producers at once
+            this->_dom.begin_batch();
+
             for (auto i : this->_cfg["init_pp"]) {
 
                 // Gaussian initialization
@@ -363,13 +491,22 @@ namespace Utopia::Models::MuLAN_MA {
                         std::swap(start, end);
                     }
 
+                    std::vector<double> traits;
                     while ( start < end ) {
-                        pp_params[1] = this->_dom.S(start, 0.0);
-                        typename DOM_T::pspace_t ps = {0, {start, 0}, pp_params};
-                        this->_org_mngr.template add_<primary_producer_t>(pp_init_mass, ps);
+                        traits.push_back(start);
                         start += step;
                     }
 
+                    // carrying capacities of the whole range at once
+                    std::vector<double> capacities(traits.size());
+                    this->_dom.S(traits.data(), traits.size(), 0.0, capacities.data());
+
+                    for (std::size_t k = 0; k < traits.size(); ++k) {
+                        pp_params[1] = capacities[k];
+                        typename DOM_T::pspace_t ps = {0, {traits[k], 0}, pp_params};
+                        this->_org_mngr.template add_<primary_producer_t>(pp_init_mass, ps);
+                    }
+
                 }
 
                 // Initialize a single producer
@@ -388,6 +525,7 @@ namespace Utopia::Models::MuLAN_MA {
                 }
 
             }
+            this->_dom.end_batch();
             this->_log->debug("Producers initialized");
 
         }
@@ -486,6 +624,11 @@ namespace Utopia::Models::MuLAN_MA {
             double sum = 0.0;
             while (sum <= this->_dt2) {
 
+                const double new_dt = this->_dom.step(this->_dt);
+
+                // rejected steps are repeated with a smaller one
+                this->_dt = this->_dom.get_last_dt();
+
                 sum += this->_dt;
 
                 if constexpr (DOM_T::step_func == 0) {
@@ -497,7 +640,7 @@ namespace Utopia::Models::MuLAN_MA {
                     throw std::invalid_argument("No valid 'perform_step' function. Check config.");
                 }
 
-                this->_dt = this->_dom.step(this->_dt);
+                this->_dt = new_dt;
 
                 if (sum + this->_dt > this->_dt2) {
                     this->_dt = this->_dt2 - sum;
@@ -512,6 +655,32 @@ namespace Utopia::Models::MuLAN_MA {
             // Mutate system
             this->mutation();
 
+            // Remove long extinct species
+            this->compaction();
+
+        }
+
+        /**
+         * @brief Remove long extinct species from the domain
+         * @details Runs every _compaction_interval mutation intervals or if the
+         *          fraction of extinct species exceeds _compaction_dead_fraction
+         *
+         */
+        void compaction() {
+
+            this->_intervals_since_compaction++;
+
+            bool periodic = this->_compaction_interval > 0
+                            && this->_intervals_since_compaction >= this->_compaction_interval;
+
+            if ( periodic || this->_dom.get_dead_fraction() > this->_compaction_dead_fraction ) {
+
+                auto removed = this->_dom.compact(this->_compaction_min_age);
+
+                this->_intervals_since_compaction = 0;
+
+                this->_log->debug("Compaction removed {} species", removed);
+            }
         }
 
         void mutation () {
@@ -525,6 +694,9 @@ namespace Utopia::Models::MuLAN_MA {
 
             trait_t_base trait_change;
 
+            // mutants of this interval get their edges in one batch
+            this->_dom.begin_batch();
+
             // iterate over all species
             for (auto v : this->_dom.get_vertices() ) {
 
@@ -533,7 +705,7 @@ namespace Utopia::Models::MuLAN_MA {
                 int type_val = tmp.get_type();
 
                 // only active ones
-                if (!tmp.active || type_val == 0 ){
+                if (!tmp.is_active() || type_val == 0 ){
                     continue;
                 }
 
@@ -594,6 +766,8 @@ namespace Utopia::Models::MuLAN_MA {
 
             }
 
+            this->_dom.end_batch();
+
             // Revive consumers
             if (*(this->cons_spec_count) <= 0) {
                 initialize_consumer();
@@ -6,6 +6,7 @@
 #include "vertex_wrapper.hh"
 #include "organism.hh"
 #include "integrators/rkck.hh"
+#include "./MuLAN_base/_kernels.hh"
 
 #ifndef UTOPIA_MY_DOMAIN_HH
 #define UTOPIA_MY_DOMAIN_HH
@@ -42,9 +43,8 @@ namespace Utopia::Models::MuLAN_MA {
          * @brief Define the chosen Integrator
          * 
          */
-        using integrator_t = std::conditional_t< INTEGRATOR == 0, 
-            rkck<CURRENCY, organism<domain_interface<CURRENCY, INTEGRATOR, SUM_SIZE, ENV_FUNC>, parameter_space> >,
-            euler<CURRENCY, organism<domain_interface<CURRENCY, INTEGRATOR, SUM_SIZE, ENV_FUNC>, parameter_space> > >;
+        using integrator_t = integrator_of< INTEGRATOR, CURRENCY,
+            organism<domain_interface<CURRENCY, INTEGRATOR, SUM_SIZE, ENV_FUNC>, parameter_space> >;
 
         using currency = typename integrator_t::currency;
 
@@ -74,7 +74,7 @@ namespace Utopia::Models::MuLAN_MA {
 
         void set_error(const currency& error){
 
-            if constexpr(INTEGRATOR == 0){
+            if constexpr(integrator_t::adaptive){
                 integrator_t::w_error = error;
             } else {
                 std::cout << "Integrator has no error estimate!" << std::endl;
@@ -82,6 +82,133 @@ namespace Utopia::Models::MuLAN_MA {
         }
 
         virtual double S(double, double) = 0;
+
+        /**
+         * @brief Time independent parts of the carrying capacity for a batch of niche positions
+         * @details S(z) = S_of(a, b, dt_loc). Cached values have to be recomputed if params change.
+         *
+         * @param z Niche positions
+         * @param n
+         * @param a Gaussian part (complete time independent value for env_func 0 and 1)
+         * @param b Amplitude of the time dependent part
+         */
+        void S_parts(const double* z, std::size_t n, double* a, double* b) const {
+
+            if constexpr (ENV_FUNC < 0 || ENV_FUNC > 3) {
+                throw std::invalid_argument("No valid 'env_func' function. Check config.");
+            }
+
+            // arguments first, exp and cos in vectorized loops
+            for (std::size_t i = 0; i < n; ++i) {
+                double tmp = z[i] / this->params[1];
+                a[i] = -1.0 * 0.5 * tmp * tmp;
+            }
+
+            for (std::size_t i = 0; i < n; ++i) {
+                a[i] = this->params[0] * kernel_exp(a[i]);
+            }
+
+            if constexpr (ENV_FUNC == 0) {
+                std::fill(b, b + n, 0.0);
+                return;
+            }
+
+            for (std::size_t i = 0; i < n; ++i) {
+                b[i] = z[i] / this->params[3];
+            }
+
+            cos_batch(b, n, b);
+
+            for (std::size_t i = 0; i < n; ++i) {
+                if constexpr (ENV_FUNC == 1) {
+                    a[i] = a[i] + this->params[2] * b[i];
+                    b[i] = 0.0;
+                } else if constexpr (ENV_FUNC == 2) {
+                    b[i] = this->params[2] * b[i];
+                } else {
+                    b[i] = this->params[2] * b[i] * b[i];
+                }
+            }
+        }
+
+        /**
+         * @brief Time independent parts of the carrying capacity
+         *
+         * @param z Niche position
+         * @param a
+         * @param b
+         */
+        void S_parts(double z, double& a, double& b) const {
+            this->S_parts(&z, 1, &a, &b);
+        }
+
+        /**
+         * @brief Carrying capacity from its time independent parts
+         *
+         * @param a
+         * @param b
+         * @param dt_loc timestep to add to current time
+         * @return double
+         */
+        double S_of(double a, double b, double dt_loc) {
+
+            if constexpr (ENV_FUNC == 0) {
+                return a;
+            } else if constexpr (ENV_FUNC == 1) {
+                return std::max(a, 0.0);
+            } else if constexpr (ENV_FUNC == 2) {
+                return std::max(a + b * this->seasonal(dt_loc), 0.0);
+            } else if constexpr (ENV_FUNC == 3) {
+                double s = this->seasonal(dt_loc);
+                return std::max(a + b * s * s, 0.0);
+            } else {
+                throw std::invalid_argument("No valid 'env_func' function. Check config.");
+            }
+        }
+
+        /**
+         * @brief Carrying capacity for a batch of niche positions
+         *
+         * @param z Niche positions
+         * @param n
+         * @param dt_loc timestep to add to current time
+         * @param out
+         */
+        void S(const double* z, std::size_t n, double dt_loc, double* out) {
+
+            thread_local std::vector<double> b;
+            b.resize(n);
+
+            this->S_parts(z, n, out, b.data());
+
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = this->S_of(out[i], b[i], dt_loc);
+            }
+        }
+
+    private:
+
+        double seasonal_arg = std::numeric_limits<double>::quiet_NaN();
+        double seasonal_val = 0.0;
+
+        /**
+         * @brief Seasonal factor of the carrying capacity
+         * @details All producers ask for the same times, the last value is kept
+         *
+         * @param dt_loc timestep to add to current time
+         * @return double
+         */
+        double seasonal(double dt_loc) {
+
+            double arg = this->params[4] * (this->time + dt_loc);
+
+            if (arg != this->seasonal_arg) {
+                this->seasonal_arg = arg;
+                this->seasonal_val = sin(arg);
+            }
+
+            return this->seasonal_val;
+        }
     };
 
 
@@ -131,32 +258,14 @@ namespace Utopia::Models::MuLAN_MA {
          */
         virtual double S(double z, double dt_loc){
 
-            if constexpr (ENV_FUNC == 0) {
-                double tmp = z / this->params[1];
-                return this->params[0] * exp(-1.0 * 0.5 * tmp * tmp);
-            } else if constexpr (ENV_FUNC == 1){
-                double tmp = z / this->params[1];
-                double tmp2 = this->params[0] * exp(-1.0 * 0.5 * tmp * tmp)
-                        + this->params[2] * cos(z/this->params[3]);
-                return std::max(tmp2, 0.0);
-            } else if constexpr (ENV_FUNC == 2){
-                double tmp = z / this->params[1];
-                double tmp2 = this->params[0] * exp(-1.0 * 0.5 * tmp * tmp)
-                       + this->params[2] * cos(z/this->params[3])
-                       * sin(this->params[4] * (this->time + dt_loc));
-                return std::max(tmp2, 0.0);
-            } else if constexpr (ENV_FUNC == 3){
-                double tmp = z / this->params[1];
-                double tmp2 =  this->params[0] * exp(-1.0 * 0.5 * tmp * tmp)
-                         + this->params[2] * cos(z/this->params[3]) * cos(z/this->params[3])
-                         * sin(this->params[4] * (this->time + dt_loc))
-                         * sin(this->params[4] * (this->time + dt_loc));
-                return std::max(tmp2, 0.0);
-            } else {
-                throw std::invalid_argument("No valid 'env_func' function. Check config.");
-            }
+            double a, b;
+            this->S_parts(z, a, b);
+
+            return this->S_of(a, b, dt_loc);
         }
 
+        using base_t::S;
+
     };
 
 
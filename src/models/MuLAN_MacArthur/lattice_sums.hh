@@ -0,0 +1,274 @@
+#ifndef UTOPIA_MODELS_LATTICE_SUMS_HH
+#define UTOPIA_MODELS_LATTICE_SUMS_HH
+
+#ifdef MULAN_USE_FFTW
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <typeindex>
+#include <utility>
+#include <vector>
+#include "MuLAN_base/_lattice_convolution.hh"
+#include "MuLAN_base/_sum_engine.hh"
+
+namespace Utopia::Models::MuLAN_MA {
+
+    /**
+     * @brief Lattice Sums
+     * @details Sum engine for producers and consumers with niche positions on a
+     *          regular lattice. The biomass is projected onto the lattice and the
+     *          consumer intake and grazing pressure are Gaussian convolutions, done
+     *          by FFT for every niche width present. Unlike the edges, the kernels
+     *          are not cut at the interaction tolerance.
+     *
+     *          Does not apply (and the domain uses the edges) if other species are
+     *          active or a niche position is off the lattice.
+     *
+     * @tparam DOM_T Domain type (domain_interface)
+     * @tparam PP_T Producer type
+     * @tparam CONS_T Consumer type
+     */
+    template <typename DOM_T, typename PP_T, typename CONS_T>
+    class lattice_sums final : public DOM_T::engine_t {
+    public:
+
+        using domain_t = typename DOM_T::engine_t::domain_t;
+
+    private:
+
+        static constexpr int response_func = CONS_T::response_func;
+
+        // largest lattice before falling back to the edges
+        static constexpr std::size_t max_sites = std::size_t(1) << 24;
+
+        lattice_convolution conv;
+
+        /**
+         * @brief Topology and active version of the layout
+         *
+         */
+        std::pair<std::size_t, std::size_t> version = {std::numeric_limits<std::size_t>::max(), 0};
+
+        bool on_lattice = false;
+
+        std::vector<PP_T*> producers;
+        std::vector<std::size_t> pp_site;
+
+        std::vector<CONS_T*> consumers;
+        std::vector<std::size_t> cons_site;
+
+        /**
+         * @brief Rows of the consumers by niche width
+         *
+         */
+        std::map<double, std::vector<std::size_t> > widths;
+
+        std::vector<double> mass;
+        std::vector<double> mass2;
+        std::vector<double> field;
+        std::vector<double> out;
+        std::vector<double> out2;
+
+        lattice_convolution::spectrum_t mass_spec;
+        lattice_convolution::spectrum_t mass2_spec;
+        lattice_convolution::spectrum_t pressure_spec;
+
+        /**
+         * @brief Lattice site of a niche position
+         *
+         * @param z
+         * @param site
+         * @return bool False if z is off the lattice
+         */
+        bool site_of(double z, long& site) const {
+            const double r = z / this->conv.get_spacing();
+            site = std::lround(r);
+            return std::abs(r - double(site)) <= 1e-9 * std::max(1.0, std::abs(r));
+        }
+
+        /**
+         * @brief Project the active species onto the lattice
+         *
+         * @param dom
+         * @return bool
+         */
+        bool layout(domain_t& dom) {
+
+            const std::pair<std::size_t, std::size_t> v = {dom.get_topology_version(), dom.species.active_version};
+
+            if (v == this->version) {
+                return this->on_lattice;
+            }
+
+            this->version = v;
+            this->on_lattice = false;
+
+            this->producers.clear();
+            this->consumers.clear();
+            this->widths.clear();
+
+            auto pp_it = dom.bucket_index.find(std::type_index(typeid(PP_T)));
+            auto cons_it = dom.bucket_index.find(std::type_index(typeid(CONS_T)));
+
+            std::vector<long> pp_sites;
+            std::vector<long> cons_sites;
+            long lo = std::numeric_limits<long>::max();
+            long hi = std::numeric_limits<long>::min();
+
+            for (auto j : dom.species.active_slots) {
+
+                const std::size_t b = dom.slot_bucket[j];
+
+                long site;
+                if (!this->site_of(dom.species.trait[j][0], site)) {
+                    return false;
+                }
+                lo = std::min(lo, site);
+                hi = std::max(hi, site);
+
+                if (pp_it != dom.bucket_index.end() && b == pp_it->second) {
+                    this->producers.push_back(static_cast<PP_T*>(dom.slot_org[j]));
+                    pp_sites.push_back(site);
+                } else if (cons_it != dom.bucket_index.end() && b == cons_it->second) {
+                    this->widths[static_cast<CONS_T*>(dom.slot_org[j])->get_constants().y].push_back(this->consumers.size());
+                    this->consumers.push_back(static_cast<CONS_T*>(dom.slot_org[j]));
+                    cons_sites.push_back(site);
+                } else {
+                    return false;
+                }
+            }
+
+            if (lo > hi || std::size_t(hi - lo) >= max_sites) {
+                return false;
+            }
+
+            const std::size_t L = std::size_t(hi - lo) + 1;
+
+            this->pp_site.assign(pp_sites.size(), 0);
+            for (std::size_t r = 0; r < pp_sites.size(); ++r) {
+                this->pp_site[r] = std::size_t(pp_sites[r] - lo);
+            }
+
+            this->cons_site.assign(cons_sites.size(), 0);
+            for (std::size_t r = 0; r < cons_sites.size(); ++r) {
+                this->cons_site[r] = std::size_t(cons_sites[r] - lo);
+            }
+
+            this->conv.resize(L);
+            this->mass.resize(L);
+            this->mass2.resize(L);
+            this->field.resize(L);
+            this->out.resize(L);
+            this->out2.resize(L);
+
+            this->mass_spec = this->conv.make_spectrum();
+            this->mass2_spec = this->conv.make_spectrum();
+            this->pressure_spec = this->conv.make_spectrum();
+
+            this->on_lattice = true;
+
+            return true;
+        }
+
+    public:
+
+        /**
+         * @brief Construct the lattice sums
+         *
+         * @param h Lattice spacing
+         */
+        explicit lattice_sums(double h = 1.0) : conv(h) {};
+
+        bool calculate_sums(domain_t& dom) override {
+
+            if (!this->layout(dom)) {
+                return false;
+            }
+
+            std::fill(this->mass.begin(), this->mass.end(), 0.0);
+            std::fill(this->mass2.begin(), this->mass2.end(), 0.0);
+
+            for (std::size_t r = 0; r < this->producers.size(); ++r) {
+                PP_T& pp = *this->producers[r];
+                const double m = pp.integrator.get_value();
+
+                this->mass[this->pp_site[r]] += m;
+                if constexpr (response_func == 4) {
+                    this->mass2[this->pp_site[r]] += m * m;
+                }
+
+                // self interaction
+                if constexpr (PP_T::pp_interaction_type == 1) {
+                    pp.integrator[1] += m;
+                }
+            }
+
+            this->conv.transform(this->mass.data(), this->mass_spec);
+            if constexpr (response_func == 4) {
+                this->conv.transform(this->mass2.data(), this->mass2_spec);
+            }
+
+            this->conv.clear(this->pressure_spec);
+
+            for (const auto& [y, rows] : this->widths) {
+
+                this->conv.convolve(this->mass_spec, y, this->out.data());
+                if constexpr (response_func == 4) {
+                    this->conv.convolve(this->mass2_spec, y, this->out2.data());
+                }
+
+                std::fill(this->field.begin(), this->field.end(), 0.0);
+
+                for (auto r : rows) {
+                    CONS_T& c = *this->consumers[r];
+                    const auto& k = c.get_constants();
+                    const std::size_t l = this->cons_site[r];
+
+                    // intake and the weight of the consumer in the grazing pressure
+                    double w = c.integrator.get_value() * k.prefactor;
+
+                    if constexpr (response_func == 1) {
+                        c.integrator[0] += k.prefactor * this->out[l];
+                    } else if constexpr (response_func == 3) {
+                        c.integrator[1] += k.prefactor * this->out[l];
+                        c.integrator[0] += k.prefactor * this->out[l] / (1 + c.integrator[1] * k.h);
+                        w /= 1 + c.integrator[1] * k.h;
+                    } else if constexpr (response_func == 4) {
+                        c.integrator[1] += k.prefactor * this->out[l];
+                        c.integrator[0] += k.prefactor * this->out2[l] / (1 + c.integrator[1]);
+                        w /= 1 + c.integrator[1];
+                    } else {
+                        throw std::invalid_argument("No valid 'response_step' function. Check config.");
+                    }
+
+                    this->field[l] += w;
+                }
+
+                this->conv.accumulate(this->field.data(), y, this->pressure_spec);
+            }
+
+            this->conv.inverse(this->pressure_spec, this->out.data());
+
+            for (std::size_t r = 0; r < this->producers.size(); ++r) {
+                PP_T& pp = *this->producers[r];
+
+                if constexpr (response_func == 4) {
+                    pp.integrator[0] += pp.integrator.get_value() * this->out[this->pp_site[r]];
+                } else {
+                    pp.integrator[0] += this->out[this->pp_site[r]];
+                }
+            }
+
+            return true;
+        }
+
+    };
+
+} // namespace Utopia::Models::MuLAN_MA
+
+#endif // MULAN_USE_FFTW
+
+#endif //UTOPIA_MODELS_LATTICE_SUMS_HH
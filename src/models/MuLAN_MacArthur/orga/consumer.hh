@@ -1,8 +1,13 @@
 #ifndef UTOPIA_MODELS_CONSUMER_HH
 #define UTOPIA_MODELS_CONSUMER_HH
 
+#include <algorithm>
+#include <cstddef>
+#include <vector>
 #include <boost/circular_buffer.hpp>
 #include "../organism.hh"
+#include "MuLAN_base/_kernels.hh"
+#include "MuLAN_base/_organism_pool.hh"
 #include "primary_producer.hh"
 #include "utils/helper.hh"
 
@@ -12,17 +17,53 @@ namespace Utopia::Models::MuLAN_MA {
     class primary_producer;
 
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
-    class consumer: public organism<DOM_T, PSPACE_T>{
+    class consumer final : public organism<DOM_T, PSPACE_T>{
     protected:
 
         //double G();
 
-        boost::circular_buffer<double> buffer;
+        /**
+         * @brief Delay buffer
+         * @details Buffers of all consumers of a domain share an arena
+         *
+         */
+        using buffer_t = boost::circular_buffer<double, pool_allocator<double> >;
+
+        buffer_t buffer;
+
+        /**
+         * @brief Front of the delay buffer at the start of the step
+         * @details A step pops at most one entry per stage, these are restored
+         *          if the step is rejected
+         *
+         */
+        std::vector<double> buffer_head;
+
+        /**
+         * @brief Evaluations of dxdt since save_state()
+         *
+         */
+        std::size_t evaluations = 0;
+
+        /**
+         * @brief Constants derived from the parameters
+         * @details Set by update_constants()
+         *
+         */
+        struct constants {
+            double R = 0.0;         // params[0]
+            double b = 0.0;         // params[1]
+            double m = 0.0;         // params[2]
+            double h = 0.0;         // params[4], response 3 only
+            double y = 1.0;         // niche width trait[1]
+            double prefactor = 0.0; // exp(-c y) / (sqrt(2 pi) y)
+        } k;
 
     public:
 
 
         using org_ptr = typename organism<DOM_T, PSPACE_T>::org_ptr;
+        using org_t = typename organism<DOM_T, PSPACE_T>::org_t;
         using currency = typename DOM_T::integrator_t::currency;
 
         static constexpr int response_func = get_from_pack<int, 0, CFGs...>();
@@ -34,16 +75,52 @@ namespace Utopia::Models::MuLAN_MA {
         const static int type_id = 1;
         static int spec_count;
 
+        // Consumers feed on producers only
+        static constexpr bool interacts_with(int type) {
+            return type == 0;
+        }
+
+        // Level 1 of the nested responses only needs the own level 0 total
+        static constexpr bool fused_sums = response_func == 3 || response_func == 4;
+
+        // All sums come from the own out edges, nobody feeds on consumers
+        static constexpr bool fused_stage = true;
+
+        // Every evaluation moves the delay buffer on
+        static constexpr bool stateful_dxdt = true;
+
         explicit consumer(DOM_T* d);
         explicit consumer(DOM_T* d, double initial_mass);
 
         ~consumer() = default;
 
-        typename DOM_T::edge_cont calc_interaction_coeff(org_ptr org2) const override;
+        typename DOM_T::edge_cont calc_interaction_coeff(const org_t& org2) const override;
+
+        void calc_interaction_coeffs(const org_t* const* others, std::size_t n,
+                                     typename DOM_T::edge_cont* out) const override;
+
+        [[nodiscard]] double interaction_radius(double tolerance, int type) const override;
+
+        void update_constants() override;
+
+        void save_state();
+
+        void restore_state();
+
+        /**
+         * @brief Constants derived from the parameters
+         *
+         * @return const constants&
+         */
+        const constants& get_constants() const {
+            return this->k;
+        }
 
 
-        void add_edge_cont1(const typename DOM_T::edge_cont& val, org_ptr organism_2) override;
-        void add_edge_cont2(const typename DOM_T::edge_cont& val, org_ptr organism_2) override;
+        void add_own_cont1(const typename DOM_T::edge_cont& val, org_t& organism_2) override;
+        void add_own_cont2(const typename DOM_T::edge_cont& val, org_t& organism_2) override;
+        void add_partner_cont1(const typename DOM_T::edge_cont& val, org_t& organism_2) override;
+        void add_partner_cont2(const typename DOM_T::edge_cont& val, org_t& organism_2) override;
 
         double get_niche_width() override {
 
@@ -8,7 +8,8 @@ namespace Utopia::Models::MuLAN_MA {
 
 
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
-    consumer<DOM_T, PSPACE_T, CFGs...>::consumer(DOM_T* d) : consumer::organism(d), buffer(d->bsize + 1){
+    consumer<DOM_T, PSPACE_T, CFGs...>::consumer(DOM_T* d) : consumer::organism(d),
+                                                              buffer(d->bsize + 1, pool_allocator<double>(d->template get_arena<buffer_t>())){
 
         this->integrator.resize(sum_size);
 
@@ -28,20 +29,18 @@ namespace Utopia::Models::MuLAN_MA {
     }
 
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
-    typename DOM_T::edge_cont consumer<DOM_T, PSPACE_T, CFGs...>::calc_interaction_coeff(const org_ptr org2) const {
+    typename DOM_T::edge_cont consumer<DOM_T, PSPACE_T, CFGs...>::calc_interaction_coeff(const org_t& org2) const {
 
-        if (org2->parameters.type == 0) {
+        if (org2.parameters.type == 0) {
             //typename primary_producer<DOM_T, PSPACE_T>::pp_ptr tmp = boost::dynamic_pointer_cast<primary_producer<DOM_T, PSPACE_T> >(org2);
 
-            double c = this->parameters.params[3];
-            double y =  this->parameters.trait[1];
-            double k = (org2->parameters.trait[0] - this->parameters.trait[0])/y;
-            double tmp = exp(-c * y)/(sqrt(2 * M_PI) * y) * exp(-0.5 * k * k);
+            double k = (org2.parameters.trait[0] - this->parameters.trait[0])/this->k.y;
+            double tmp = this->k.prefactor * kernel_exp(-0.5 * k * k);
 
             return typename DOM_T::edge_cont{tmp};
             //return typename DOM_T::edge_cont{this->calc_z_coeff(*tmp)};
 
-        } else if (org2->parameters.type == 1) {
+        } else if (org2.parameters.type == 1) {
 
 
             // cons_ptr tmp = boost::dynamic_pointer_cast<consumer>(org2);
@@ -50,32 +49,91 @@ namespace Utopia::Models::MuLAN_MA {
 
         } else {
 
-            assert(org2->parameters.type == 1);
+            assert(org2.parameters.type == 1);
 
         }
 
         return typename DOM_T::edge_cont{0.0};
     }
 
+    template <typename DOM_T, typename PSPACE_T, int ...CFGs>
+    void consumer<DOM_T, PSPACE_T, CFGs...>::calc_interaction_coeffs(const org_t* const* others, std::size_t n,
+                                                                      typename DOM_T::edge_cont* out) const {
+
+        thread_local std::vector<double> k;
+        thread_local std::vector<double> z;
+        k.resize(n);
+        z.resize(n);
+
+        const double t0 = this->parameters.trait[0];
+
+        // distances first, the exponentials in one vectorized loop
+        for (std::size_t i = 0; i < n; ++i) {
+            k[i] = (others[i]->parameters.trait[0] - t0)/this->k.y;
+        }
+
+        gaussian_batch(k.data(), n, this->k.prefactor, z.data());
+
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = typename DOM_T::edge_cont{others[i]->parameters.type == 0 ? z[i] : 0.0};
+        }
+    }
+
+    template <typename DOM_T, typename PSPACE_T, int ...CFGs>
+    double consumer<DOM_T, PSPACE_T, CFGs...>::interaction_radius(double tolerance, int type) const {
+
+        if (tolerance <= 0.0) {
+            return std::numeric_limits<double>::infinity();
+        }
+
+        // consumers only feed on producers
+        if (type != 0) {
+            return -1.0;
+        }
+
+        // prefactor * exp(-0.5 k^2) > tolerance  <=>  |k| < sqrt(2 log(prefactor / tolerance))
+        // too costly to link to anything
+        if (this->k.prefactor <= tolerance) {
+            return -1.0;
+        }
+
+        return this->k.y * sqrt(2 * log(this->k.prefactor / tolerance));
+    }
+
+    template <typename DOM_T, typename PSPACE_T, int ...CFGs>
+    void consumer<DOM_T, PSPACE_T, CFGs...>::update_constants() {
+
+        this->k.R = this->parameters.params[0];
+        this->k.b = this->parameters.params[1];
+        this->k.m = this->parameters.params[2];
+
+        if constexpr ( response_func == 3 ) {
+            this->k.h = this->parameters.params[4];
+        }
+
+        double c = this->parameters.params[3];
+        double y =  this->parameters.trait[1];
+
+        this->k.y = y;
+        this->k.prefactor = exp(-c * y)/(sqrt(2 * M_PI) * y);
+    }
+
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
     double consumer<DOM_T, PSPACE_T, CFGs...>::get_influx(){
-        double b = this->parameters.params[1];
-        return b * this->integrator[0];
+        return this->k.b * this->integrator[0];
     }
 
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
     double consumer<DOM_T, PSPACE_T, CFGs...>::dxdt(const currency& x, [[maybe_unused]] const double tpdt) {
 
-        double R = this->parameters.params[0];
-        double b = this->parameters.params[1];
-        double m = this->parameters.params[2];
-
-        double ret = x * R * (b * this->integrator[0] - m);
+        double ret = x * this->k.R * (this->k.b * this->integrator[0] - this->k.m);
 
 
 
         this->integrator.clear_sum();
 
+        this->evaluations++;
+
         if (ret >= 0.0){
             this->buffer.push_back(ret);
 
@@ -98,20 +156,45 @@ namespace Utopia::Models::MuLAN_MA {
     }
 
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
-    void consumer<DOM_T, PSPACE_T, CFGs...>::add_edge_cont1(const typename DOM_T::edge_cont& val, org_ptr organism_2) {
+    void consumer<DOM_T, PSPACE_T, CFGs...>::save_state() {
+
+        const std::size_t k = std::min<std::size_t>(DOM_T::integrator_t::steps, this->buffer.size());
+
+        this->buffer_head.assign(this->buffer.begin(), this->buffer.begin() + k);
+        this->evaluations = 0;
+
+    }
+
+    template <typename DOM_T, typename PSPACE_T, int ...CFGs>
+    void consumer<DOM_T, PSPACE_T, CFGs...>::restore_state() {
+
+        // every evaluation appended one entry and popped one from the front
+        const std::size_t m = std::min(this->evaluations, this->buffer.size());
+
+        for (std::size_t r = 0; r < m; ++r) {
+            this->buffer.pop_back();
+        }
+        for (std::size_t r = m; r > 0; --r) {
+            this->buffer.push_front(this->buffer_head[r - 1]);
+        }
+
+        this->evaluations = 0;
+
+    }
+
+    template <typename DOM_T, typename PSPACE_T, int ...CFGs>
+    void consumer<DOM_T, PSPACE_T, CFGs...>::add_own_cont1(const typename DOM_T::edge_cont& val, org_t& organism_2) {
 
         if constexpr ( response_func == 1 ) {
-            const currency &mass = organism_2->get_value();
-            const currency &x = this->get_value();
+            const currency &mass = organism_2.get_value();
 
             this->integrator[0] += mass * val[0];
-            organism_2->integrator[0] += x * val[0];
         } else if constexpr ( response_func == 3 ) {
-            const currency &mass = organism_2->get_value();
+            const currency &mass = organism_2.get_value();
 
             this->integrator[1] += mass * val[0];
         } else if constexpr ( response_func == 4 ) {
-            const currency &mass = organism_2->get_value();
+            const currency &mass = organism_2.get_value();
 
             // this->integrator[1] += this->parameters.params[4] * mass * val[0] *  mass * val[0]
             //                         + this->parameters.params[5] * mass * val[0];
@@ -122,26 +205,58 @@ namespace Utopia::Models::MuLAN_MA {
         }
     }
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
-    void consumer<DOM_T, PSPACE_T, CFGs...>::add_edge_cont2(const typename DOM_T::edge_cont& val, const org_ptr organism_2) {
+    void consumer<DOM_T, PSPACE_T, CFGs...>::add_own_cont2(const typename DOM_T::edge_cont& val, org_t& organism_2) {
 
         if constexpr ( response_func == 1 ) {
 
         } else if constexpr ( response_func == 3 ) {
-            const currency &mass = organism_2->get_value();
-            const currency &x = this->get_value();
+            const currency &mass = organism_2.get_value();
 
-            auto tmp = val[0]/(1 + this->integrator[1] * this->parameters.params[4]);
+            auto tmp = val[0]/(1 + this->integrator[1] * this->k.h);
 
             this->integrator[0] += mass * tmp;
-            organism_2->integrator[0] += x * tmp;
         } else if constexpr ( response_func == 4 ) {
-            const currency &mass = organism_2->get_value();
-            const currency &x = this->get_value();
+            const currency &mass = organism_2.get_value();
 
             auto tmp = val[0]/(1 + this->integrator[1]);
 
             this->integrator[0] += mass * mass * tmp;
-            organism_2->integrator[0] += x * mass * tmp;
+        } else {
+            throw std::invalid_argument("No valid 'response_step' function. Check config.");
+        }
+    }
+
+    template <typename DOM_T, typename PSPACE_T, int ...CFGs>
+    void consumer<DOM_T, PSPACE_T, CFGs...>::add_partner_cont1(const typename DOM_T::edge_cont& val, org_t& organism_2) {
+
+        if constexpr ( response_func == 1 ) {
+            const currency &x = this->get_value();
+
+            organism_2.integrator[0] += x * val[0];
+        } else if constexpr ( response_func == 3 || response_func == 4 ) {
+
+        } else {
+            throw std::invalid_argument("No valid 'response_step' function. Check config.");
+        }
+    }
+    template <typename DOM_T, typename PSPACE_T, int ...CFGs>
+    void consumer<DOM_T, PSPACE_T, CFGs...>::add_partner_cont2(const typename DOM_T::edge_cont& val, org_t& organism_2) {
+
+        if constexpr ( response_func == 1 ) {
+
+        } else if constexpr ( response_func == 3 ) {
+            const currency &x = this->get_value();
+
+            auto tmp = val[0]/(1 + this->integrator[1] * this->k.h);
+
+            organism_2.integrator[0] += x * tmp;
+        } else if constexpr ( response_func == 4 ) {
+            const currency &mass = organism_2.get_value();
+            const currency &x = this->get_value();
+
+            auto tmp = val[0]/(1 + this->integrator[1]);
+
+            organism_2.integrator[0] += x * mass * tmp;
         } else {
             throw std::invalid_argument("No valid 'response_step' function. Check config.");
         }
@@ -12,12 +12,13 @@ namespace MuLAN_MA {
     class consumer;
 
     template <typename DOM_T, typename PSPACE_T, int ...CFGs>
-    class primary_producer: public organism<DOM_T, PSPACE_T>{
+    class primary_producer final : public organism<DOM_T, PSPACE_T>{
 
     public:
 
         using pp_ptr [[maybe_unused]] = boost::shared_ptr<primary_producer>;
         using org_ptr = typename organism<DOM_T, PSPACE_T>::org_ptr;
+        using org_t = typename organism<DOM_T, PSPACE_T>::org_t;
         using currency = typename DOM_T::integrator_t::currency;
 
         // Interaction between producers CFGs[0]
@@ -29,7 +30,7 @@ namespace MuLAN_MA {
             double logistic_term;
 
             if constexpr ( DOM_T::env_func == 2 || DOM_T::env_func == 3 ) {
-                this->parameters.params[1] = this->dom->S(this->parameters.trait[0], tpdt);
+                this->parameters.params[1] = this->dom->S_of(this->S_a, this->S_b, tpdt);
             } else {
 
             }
@@ -52,9 +53,18 @@ namespace MuLAN_MA {
         // Producers ID: 0
         const static int type_id = 0;
 
+        // Producers only interact with themselves
+        static constexpr bool interacts_with(int type) {
+            return pp_interaction_type == 1 && type == 0;
+        }
+
         // Store number of species
         static int spec_count;
 
+        // Time independent parts of the carrying capacity, set by update_constants()
+        double S_a = 0.0;
+        double S_b = 0.0;
+
         /**
          * @brief Construct a producer with access to  domain d
          *
@@ -92,17 +102,27 @@ namespace MuLAN_MA {
         ~primary_producer() = default;
 
 
+        /**
+         * @brief Cache the time independent parts of the carrying capacity
+         *
+         */
+        void update_constants() override {
+            if constexpr ( DOM_T::env_func == 2 || DOM_T::env_func == 3 ) {
+                this->dom->S_parts(this->parameters.trait[0], this->S_a, this->S_b);
+            }
+        }
+
         /**
          * @brief Calculate the interaction edge of this and org2
          *
          * @param org2  Organism
          * @return
          */
-        typename DOM_T::edge_cont calc_interaction_coeff(const org_ptr org2) const override {
-            if (org2->parameters.type == 0) {
+        typename DOM_T::edge_cont calc_interaction_coeff(const org_t& org2) const override {
+            if (org2.parameters.type == 0) {
                 if constexpr (pp_interaction_type == 1 ) {
 
-                    if (org2.get() == this) {
+                    if (&org2 == this) {
                         return typename DOM_T::edge_cont{1.0};
                     }
 
@@ -114,16 +134,45 @@ namespace MuLAN_MA {
         }
 
 
-        void add_edge_cont1(const typename DOM_T::edge_cont& val, org_ptr organism_2) override {
+        /**
+         * @brief Producers only interact with themselves
+         *
+         * @param tolerance
+         * @param type
+         * @return double
+         */
+        [[nodiscard]] double interaction_radius(double tolerance, int type) const override {
+            if (tolerance <= 0.0) {
+                return std::numeric_limits<double>::infinity();
+            }
+            if constexpr (pp_interaction_type == 1) {
+                if (type == 0) {
+                    return 0.0;
+                }
+            }
+            return -1.0;
+        }
+
+        void add_own_cont1(const typename DOM_T::edge_cont& /*val*/, org_t& /*organism_2*/) override {
+
+            return;
+        }
+
+        void add_own_cont2(const typename DOM_T::edge_cont& /*val*/, org_t& /*organism_2*/) override {
+
+            return;
+        }
+
+        void add_partner_cont1(const typename DOM_T::edge_cont& val, org_t& organism_2) override {
             if constexpr ( pp_interaction_type == 1 ) {
-                const currency &mass = organism_2->get_value();
-                organism_2->integrator[1] += val[0] * mass;
+                const currency &mass = organism_2.get_value();
+                organism_2.integrator[1] += val[0] * mass;
             } else {
                 return;
             }
         }
 
-        void add_edge_cont2(const typename DOM_T::edge_cont& /*val*/, const org_ptr /*organism_2*/) override {
+        void add_partner_cont2(const typename DOM_T::edge_cont& /*val*/, org_t& /*organism_2*/) override {
 
             return;
         }
@@ -22,6 +22,7 @@ namespace Utopia::Models::MuLAN_MA {
         using currency = typename DOM_T::integrator_t::currency;
         using edge_cont = typename DOM_T::edge_cont;
         using org_ptr = typename organism<DOM_T, PSPACE_T>::org_ptr;
+        using org_t = organism<DOM_T, PSPACE_T>;
 
         /**
          * @brief Construct a new organism object
@@ -34,7 +35,7 @@ namespace Utopia::Models::MuLAN_MA {
 
         virtual double get_niche_width(){ return 0.0; };
 
-        virtual double get_influx(){ return this->integrator.last_dxdt; };
+        virtual double get_influx(){ return this->integrator.get_last_dxdt(); };
 
 
         /**
@@ -48,25 +49,62 @@ namespace Utopia::Models::MuLAN_MA {
 
         /**
          * @brief Interface to add Edges to the sum vector of an organism pair
-         * @details Call virtual functions e.g. add_edge_contX of organisms
+         * @details Adds both halves of the edge, see add_own_cont and add_partner_cont.
+         *          If the dynamic type SELF is known (and final) the calls are resolved statically.
          *
          * @tparam N Depth of sums e.g. if sum is sum of sums
+         * @tparam SELF Dynamic type of this organism
          * @param val Edge value (scalar or vector)
          * @param organism_2 The second organism
          */
-        template<int N>
-        void add_edge_cont(const edge_cont& val, org_ptr organism_2) {
+        template<int N, typename SELF = organism>
+        void add_edge_cont(const edge_cont& val, org_t& organism_2) {
+            this->template add_own_cont<N, SELF>(val, organism_2);
+            this->template add_partner_cont<N, SELF>(val, organism_2);
+        };
+
+        /**
+         * @brief Add the part of an out edge that goes into the sums of this organism
+         * @details Only writes to this organism
+         *
+         * @tparam N Depth of sums
+         * @tparam SELF Dynamic type of this organism
+         * @param val Edge value (scalar or vector)
+         * @param organism_2 Target of the edge
+         */
+        template<int N, typename SELF = organism>
+        void add_own_cont(const edge_cont& val, org_t& organism_2) {
+            SELF& self = static_cast<SELF&>(*this);
+            if constexpr ( N == 0 ) {
+                self.add_own_cont1(val, organism_2);
+            } else if constexpr ( N == 1 ) {
+                self.add_own_cont2(val, organism_2);
+            }
+        };
+
+        /**
+         * @brief Add the part of an out edge that goes into the sums of the target
+         * @details Only writes to organism_2. May read sums of this organism below level N.
+         *
+         * @tparam N Depth of sums
+         * @tparam SELF Dynamic type of this organism
+         * @param val Edge value (scalar or vector)
+         * @param organism_2 Target of the edge
+         */
+        template<int N, typename SELF = organism>
+        void add_partner_cont(const edge_cont& val, org_t& organism_2) {
+            SELF& self = static_cast<SELF&>(*this);
             if constexpr ( N == 0 ) {
-                this->add_edge_cont1(val, organism_2);
-            } if constexpr ( N == 1 ) {
-                this->add_edge_cont2(val, organism_2);
-            } else {
-                return;
+                self.add_partner_cont1(val, organism_2);
+            } else if constexpr ( N == 1 ) {
+                self.add_partner_cont2(val, organism_2);
             }
         };
 
-        virtual void add_edge_cont1(const edge_cont& val, org_ptr organism_2) = 0;
-        virtual void add_edge_cont2(const edge_cont& val, org_ptr organism_2) = 0;
+        virtual void add_own_cont1(const edge_cont& val, org_t& organism_2) = 0;
+        virtual void add_own_cont2(const edge_cont& val, org_t& organism_2) = 0;
+        virtual void add_partner_cont1(const edge_cont& val, org_t& organism_2) = 0;
+        virtual void add_partner_cont2(const edge_cont& val, org_t& organism_2) = 0;
 
     };
 
@@ -2,7 +2,11 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/mpl/list.hpp>
 
+#include <set>
+#include <tuple>
+
 #include "../domain.hh"
+#include "../lattice_sums.hh"
 
 #include "../orga/primary_producer.hh"
 #include "../orga/consumer_impl.hh"
@@ -100,6 +104,1095 @@ BOOST_AUTO_TEST_CASE_TEMPLATE (necessary_funcs, Dom, Doms)
 }
 
 
+BOOST_AUTO_TEST_CASE_TEMPLATE (interaction_matrix, Dom, Doms)
+{
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 0>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    for (double t = -2.0; t <= 2.0; t += 1.0) {
+        typename Dom::pspace_t ps = {0, {t, 0}, {10, dom.S(t, 0.0)}};
+        dom.template add_<pp_t>(5, ps);
+    }
+
+    typename Dom::pspace_t ps_c = {1, {0, 2}, {0.7, 0.8, 5.0, 0.0}};
+    dom.template add_<cons_t>(5, ps_c);
+
+    auto version = dom.get_topology_version();
+    dom.update_interactions();
+
+    // The snapshot holds every edge of the graph in slot indices
+    BOOST_TEST( dom.interactions.size() == num_edges(dom.graph) );
+    BOOST_TEST( dom.interactions.row.size() == num_vertices(dom.graph) + 1 );
+
+    for (std::size_t k = 0; k < dom.interactions.size(); ++k) {
+        auto s = dom.interactions.source[k];
+        auto t = dom.interactions.target[k];
+        BOOST_TEST( dom.interactions.row[s] <= k );
+        BOOST_TEST( k < dom.interactions.row[s + 1] );
+        BOOST_TEST( dom.species.type[s] == 1 );
+        BOOST_TEST( dom.species.type[t] == 0 );
+        BOOST_TEST( dom[dom.slot_vertex[s]].org->calc_interaction_coeff(dom[dom.slot_vertex[t]].org)
+                    == dom.interactions.weight[k] );
+    }
+
+    // Adding existing species does not change the topology
+    dom.template add_<cons_t>(1, ps_c);
+    BOOST_TEST( dom.get_topology_version() == version );
+
+    // A new species does
+    typename Dom::pspace_t ps_c2 = {1, {1, 2}, {0.7, 0.8, 5.0, 0.0}};
+    dom.template add_<cons_t>(1, ps_c2);
+    BOOST_TEST( dom.get_topology_version() > version );
+
+    dom.update_interactions();
+    BOOST_TEST( dom.interactions.size() == num_edges(dom.graph) );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (compaction, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 0>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom, dom_ref;
+
+    typename Dom::pspace_t ps = {0, {0, 0}, {10, 100.0}};
+    typename Dom::pspace_t ps_c1 = {1, {0, 2}, {0.7, 0.8, 5.0, 0.0}};
+    typename Dom::pspace_t ps_c2 = {1, {50, 2}, {0.7, 0.8, 5.0, 0.0}};
+    typename Dom::pspace_t ps_c3 = {1, {1, 2}, {0.7, 0.8, 5.0, 0.0}};
+
+    for (auto d : {&dom, &dom_ref}) {
+        d->params = std::vector<double>({100.0, 100.0});
+        d->template add_<pp_t>(5, ps);
+        d->template add_<cons_t>(5, ps_c1);
+        d->template add_<cons_t>(5, ps_c2);
+    }
+
+    double dt = 0.01, dt_ref = 0.01;
+    for (int i = 0; i < 1000; i++) {
+        dt = dom.step(dt);
+        dt_ref = dom_ref.step(dt_ref);
+    }
+
+    // Consumer 2 has no food and died out
+    BOOST_TEST( dom.get_dead_fraction() == 1.0 / 3.0 );
+
+    // Too young to be removed
+    BOOST_TEST( dom.compact(2.0 * dom.get_time()) == 0 );
+
+    auto id_c1 = dom[ps_c1].id;
+    BOOST_TEST( dom.compact() == 1 );
+
+    // The dead species is gone from the graph, the map and the store
+    BOOST_TEST( num_vertices(dom.graph) == 2 );
+    BOOST_TEST( dom.psm.count(ps_c2) == 0 );
+    BOOST_TEST( dom.species.size() == 2 );
+    BOOST_TEST( dom.get_dead_fraction() == 0.0 );
+
+    // Ids are stable and views still point to the correct species
+    BOOST_TEST( dom[ps_c1].id == id_c1 );
+    BOOST_TEST( dom[ps_c1].get_trait() == ps_c1.trait );
+    BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass() );
+
+    // New species get new ids and slots
+    dom.template add_<cons_t>(1, ps_c3);
+    dom_ref.template add_<cons_t>(1, ps_c3);
+    BOOST_TEST( dom[ps_c3].id == 3 );
+    BOOST_TEST( dom[ps_c3].idx == 2 );
+
+    // Removing extinct species does not change the dynamics
+    for (int i = 0; i < 100; i++) {
+        dt = dom.step(dt);
+        dt_ref = dom_ref.step(dt_ref);
+    }
+
+    BOOST_TEST( dt == dt_ref );
+    BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass() );
+    BOOST_TEST( dom[ps_c1].get_mass() == dom_ref[ps_c1].get_mass() );
+    BOOST_TEST( dom[ps_c3].get_mass() == dom_ref[ps_c3].get_mass() );
+}
+
+BOOST_AUTO_TEST_CASE (compaction_drifted_keys)
+{
+    // the carrying capacity in the parameters of producers follows the season
+    using Dom = domain<double, 0, 0, 1, 2>;
+    using pp_t = primary_producer<Dom::base_t, Dom::pspace_t, 0>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 30.0, 20.0, 5.0, 0.5});
+
+    Dom::pspace_t ps_1 = {0, {-1, 0}, {10, 100.0}};
+    Dom::pspace_t ps_2 = {0, {1, 0}, {10, 100.0}};
+    Dom::pspace_t ps_3 = {0, {3, 0}, {10, 100.0}};
+
+    dom.add_<pp_t>(5, ps_1);
+    dom.add_<pp_t>(5, ps_2);
+    dom.add_<pp_t>(5, ps_3);
+
+    for (int i = 0; i < 10; i++) {
+        dom.step(0.01);
+    }
+
+    BOOST_TEST( !(dom[ps_1].org->parameters == ps_1) );
+
+    dom[ps_1].set_mass(0.0);
+    dom[ps_2].set_mass(0.0);
+    dom.step(0.01);
+
+    BOOST_TEST( dom.compact(0.0) == 2 );
+    BOOST_TEST( dom.psm.size() == 1 );
+    BOOST_TEST( dom.psm.count(ps_3) == 1 );
+
+    // the removed producers come back as new species
+    dom.add_<pp_t>(2, ps_1);
+    BOOST_TEST( num_vertices(dom.graph) == 2 );
+    BOOST_TEST( dom[ps_1].get_mass() == 2.0 );
+    BOOST_TEST( dom[ps_1].is_active() );
+
+    dom.step(0.01);
+    BOOST_TEST( dom[ps_3].is_active() );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (active_index, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 0>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+
+    typename Dom::pspace_t ps = {0, {0, 0}, {10, 100.0}};
+    typename Dom::pspace_t ps_c1 = {1, {0, 2}, {0.7, 0.8, 5.0, 0.0}};
+    typename Dom::pspace_t ps_c2 = {1, {50, 2}, {0.7, 0.8, 5.0, 0.0}};
+
+    dom.template add_<pp_t>(5, ps);
+    dom.template add_<cons_t>(5, ps_c1);
+    dom.template add_<cons_t>(5, ps_c2);
+
+    double dt = 0.01;
+    for (int i = 0; i < 1000; i++) {
+        dt = dom.step(dt);
+    }
+
+    // One bucket per species type
+    BOOST_TEST( dom.buckets.size() == 2 );
+    BOOST_TEST( dom.slot_bucket[dom[ps_c1].idx] == dom.slot_bucket[dom[ps_c2].idx] );
+    BOOST_TEST( dom.slot_bucket[dom[ps].idx] != dom.slot_bucket[dom[ps_c2].idx] );
+
+    // Consumer 2 died out and left the active list
+    std::size_t i_c2 = dom[ps_c2].idx;
+    BOOST_TEST( dom.species.count_active() == 2 );
+    BOOST_TEST( std::count(dom.species.active_slots.begin(), dom.species.active_slots.end(), i_c2) == 0 );
+    for (auto& bucket : dom.buckets) {
+        for (auto& block : bucket->blocks) {
+            for (std::size_t k = 0; k < block.size(); ++k) {
+                BOOST_TEST( block.source[k] != i_c2 );
+                BOOST_TEST( block.target[k] != i_c2 );
+            }
+        }
+    }
+
+    // Reactivation puts it back in order
+    dom.template add_<cons_t>(5, ps_c2);
+    BOOST_TEST( dom[ps_c2].is_active() );
+    BOOST_TEST( std::is_sorted(dom.species.active_slots.begin(), dom.species.active_slots.end()) );
+    BOOST_TEST( dom.species.count_active() == 3 );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (block_layout, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 0>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom, dom_ref;
+    dom.set_block_layout(true);
+
+    // producers and consumers interleaved
+    for (auto d : {&dom, &dom_ref}) {
+        d->params = std::vector<double>({100.0, 100.0});
+        for (double t = 0.0; t < 4.0; t += 1.0) {
+            typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            typename Dom::pspace_t ps_c = {1, {t, 2}, {0.7, 0.8, 5.0, 0.0}};
+            d->template add_<pp_t>(5, ps);
+            d->template add_<cons_t>(5, ps_c);
+        }
+    }
+
+    // Nothing to remove, but the slots are grouped by type
+    BOOST_TEST( dom.compact() == 0 );
+    BOOST_TEST( std::is_sorted(dom.slot_bucket.begin(), dom.slot_bucket.end()) );
+    typename Dom::pspace_t ps_last = {0, {3, 0}, {10, 100.0}};
+    BOOST_TEST( dom[ps_last].idx == 3 );
+
+    double dt = 0.01, dt_ref = 0.01;
+    for (int i = 0; i < 100; i++) {
+        dt = dom.step(dt);
+        dt_ref = dom_ref.step(dt_ref);
+    }
+
+    BOOST_TEST( dt == dt_ref );
+    for (double t = 0.0; t < 4.0; t += 1.0) {
+        typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+        typename Dom::pspace_t ps_c = {1, {t, 2}, {0.7, 0.8, 5.0, 0.0}};
+        BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass() );
+        BOOST_TEST( dom[ps_c].get_mass() == dom_ref[ps_c].get_mass() );
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (trait_index, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+    dom.set_interaction_tolerance(1.0e-4);
+
+    for (double t = -50.0; t <= 50.0; t += 1.0) {
+        typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+        dom.template add_<pp_t>(5, ps);
+    }
+    for (double t = -40.0; t <= 40.0; t += 7.0) {
+        typename Dom::pspace_t ps_c = {1, {t, 1.0 + std::abs(t) / 10.0}, {0.7, 0.8, 0.1, 0.0}};
+        dom.template add_<cons_t>(5, ps_c);
+    }
+
+    // The radius is a bound on the kernel
+    auto& c = *dom.slot_org[dom.species.size() - 1];
+    double r = c.interaction_radius(dom.interaction_tolerance, 0);
+    BOOST_TEST( r > 0.0 );
+    BOOST_TEST( c.interaction_radius(dom.interaction_tolerance, 1) < 0.0 );
+    for (std::size_t i = 0; i < dom.species.size(); ++i) {
+        if (std::abs(dom.species.trait[i][0] - c.parameters.trait[0]) > r) {
+            BOOST_TEST( c.calc_interaction_coeff(*dom.slot_org[i])[0] <= dom.interaction_tolerance );
+        }
+    }
+
+    // Same edges as a full scan
+    std::size_t n_edges = 0;
+    for (auto a : dom.slot_org) {
+        for (auto b : dom.slot_org) {
+            n_edges += a->calc_interaction_coeff(*b)[0] > dom.interaction_tolerance;
+        }
+    }
+    BOOST_TEST( num_edges(dom.graph) == n_edges );
+
+    // Too costly consumers get no edges at all
+    auto n = num_edges(dom.graph);
+    typename Dom::pspace_t ps_c = {1, {0.0, 1.0}, {0.7, 0.8, 0.1, 20.0}};
+    auto& vw = dom.template add_<cons_t>(5, ps_c);
+    BOOST_TEST( vw.org->interaction_radius(dom.interaction_tolerance, 0) < 0.0 );
+    BOOST_TEST( num_edges(dom.graph) == n );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (batch_insertion, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom, dom_ref;
+
+    for (auto d : {&dom, &dom_ref}) {
+        d->params = std::vector<double>({100.0, 100.0});
+        d->set_interaction_tolerance(1.0e-4);
+        for (double t = -20.0; t <= 20.0; t += 1.0) {
+            typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            d->template add_<pp_t>(5, ps);
+        }
+    }
+
+    // a burst of mutants, some of them close to each other or identical
+    dom.begin_batch();
+    for (auto d : {&dom, &dom_ref}) {
+        for (double t = -15.0; t <= 15.0; t += 2.5) {
+            typename Dom::pspace_t ps_c = {1, {t, 1.0 + std::abs(t) / 5.0}, {0.7, 0.8, 0.1, 0.0}};
+            d->template add_<cons_t>(1, ps_c);
+            d->template add_<cons_t>(1, ps_c);
+        }
+        typename Dom::pspace_t ps = {0, {0.5, 0}, {10, 100.0}};
+        d->template add_<pp_t>(5, ps);
+    }
+    BOOST_TEST( num_edges(dom.graph) < num_edges(dom_ref.graph) );
+    dom.end_batch();
+
+    // Same edges in the same order as one by one
+    BOOST_TEST( num_edges(dom.graph) == num_edges(dom_ref.graph) );
+
+    dom.update_interactions();
+    dom_ref.update_interactions();
+    BOOST_TEST( dom.interactions.row == dom_ref.interactions.row, boost::test_tools::per_element() );
+    BOOST_TEST( dom.interactions.target == dom_ref.interactions.target, boost::test_tools::per_element() );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (parallel_edges, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom, dom_ref;
+
+    dom.set_threads(4);
+    dom.parallel_threshold = 1;
+
+    for (auto d : {&dom, &dom_ref}) {
+        d->params = std::vector<double>({100.0, 100.0});
+        d->set_interaction_tolerance(1.0e-4);
+        for (double t = -50.0; t <= 50.0; t += 1.0) {
+            typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            d->template add_<pp_t>(5, ps);
+        }
+        for (double t = -30.0; t <= 30.0; t += 3.0) {
+            typename Dom::pspace_t ps_c = {1, {t, 10.0}, {0.7, 0.8, 0.1, 0.0}};
+            d->template add_<cons_t>(1, ps_c);
+        }
+    }
+
+    // a batch goes through the pool as well
+    dom.begin_batch();
+    for (auto d : {&dom, &dom_ref}) {
+        for (double t = -29.0; t <= 29.0; t += 4.0) {
+            typename Dom::pspace_t ps_c = {1, {t, 5.0}, {0.7, 0.8, 0.1, 0.0}};
+            d->template add_<cons_t>(1, ps_c);
+        }
+    }
+    dom.end_batch();
+
+    // Same edges in the same order as the serial path
+    BOOST_TEST( num_edges(dom.graph) == num_edges(dom_ref.graph) );
+
+    dom.update_interactions();
+    dom_ref.update_interactions();
+    BOOST_TEST( dom.interactions.row == dom_ref.interactions.row, boost::test_tools::per_element() );
+    BOOST_TEST( dom.interactions.target == dom_ref.interactions.target, boost::test_tools::per_element() );
+
+    std::vector<double> w, w_ref;
+    for (std::size_t k = 0; k < dom.interactions.weight.size(); ++k) {
+        w.push_back(dom.interactions.weight[k][0]);
+        w_ref.push_back(dom_ref.interactions.weight[k][0]);
+    }
+    BOOST_TEST( w == w_ref, boost::test_tools::per_element() );
+}
+
+BOOST_AUTO_TEST_CASE (thread_pool_exceptions)
+{
+    thread_pool pool(4);
+
+    // exceptions of the workers and of the calling thread reach the caller
+    for (std::size_t thrower : {0u, 90u}) {
+        std::vector<int> done(100, 0);
+        BOOST_CHECK_THROW( pool.parallel_for(100, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                if (i == thrower) {
+                    throw std::runtime_error("chunk failed");
+                }
+                done[i] = 1;
+            }
+        }), std::runtime_error );
+
+        // all other chunks ran to the end
+        BOOST_TEST( done[thrower] == 0 );
+        BOOST_TEST( done[(thrower + 50) % 100] == 1 );
+    }
+
+    // the pool is still usable
+    std::vector<int> done(100, 0);
+    pool.parallel_for(100, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            done[i] = 1;
+        }
+    });
+    BOOST_TEST( std::count(done.begin(), done.end(), 1) == 100 );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (pair_table, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 0>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+    dom.set_interaction_tolerance(1.0e-4);
+
+    typename Dom::pspace_t ps = {0, {0, 0}, {10, 100.0}};
+    dom.template add_<pp_t>(5, ps);
+    typename Dom::pspace_t ps_c = {1, {0, 2}, {0.7, 0.8, 5.0, 0.0}};
+    dom.template add_<cons_t>(1, ps_c);
+
+    const auto pp = dom.template get_bucket<pp_t>();
+    const auto cons = dom.template get_bucket<cons_t>();
+
+    // Consumers feed on producers, nothing else interacts
+    BOOST_TEST( dom.pair_mask(pp, pp) == 0 );
+    BOOST_TEST( dom.pair_mask(cons, cons) == 0 );
+    BOOST_TEST( dom.pair_mask(cons, pp) == 1 );
+    BOOST_TEST( dom.pair_mask(pp, cons) == 2 );
+
+    BOOST_TEST( num_edges(dom.graph) == 1 );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (gathered_sums, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 0>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom, dom_ref;
+
+    dom.set_gather_sums(true);
+    dom.set_threads(3);
+    dom.parallel_threshold = 1;
+
+    std::vector<typename Dom::pspace_t> all;
+
+    for (auto d : {&dom, &dom_ref}) {
+        d->params = std::vector<double>({100.0, 100.0});
+        d->set_interaction_tolerance(1.0e-4);
+        all.clear();
+        for (double t = -20.0; t <= 20.0; t += 1.0) {
+            typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            d->template add_<pp_t>(5, ps);
+            all.push_back(ps);
+        }
+        for (double t = -10.0; t <= 10.0; t += 2.0) {
+            typename Dom::pspace_t ps_c = {1, {t, 3.0}, {0.7, 0.8, 0.1, 0.0}};
+            d->template add_<cons_t>(1, ps_c);
+            all.push_back(ps_c);
+        }
+    }
+
+    double dt = 0.01;
+    double dt_ref = 0.01;
+    for (int s = 0; s < 20; ++s) {
+        dt = dom.step(dt);
+        dt_ref = dom_ref.step(dt_ref);
+    }
+
+    // Producers get the consumption of their consumers from the in edges
+    for (auto& ps : all) {
+        BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass(), boost::test_tools::tolerance(1e-12) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE (fused_sums)
+{
+    using Dom = domain<double, 0, 0, 2, 0>;
+    using pp_t = primary_producer<Dom::base_t, Dom::pspace_t, 0>;
+    using cons_t = consumer<Dom::base_t, Dom::pspace_t, 3>;
+
+    static_assert(cons_t::fused_sums);
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+    dom.set_interaction_tolerance(1.0e-4);
+
+    for (double t = -10.0; t <= 10.0; t += 1.0) {
+        Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+        dom.add_<pp_t>(5.0 + t, ps);
+    }
+    for (double t = -6.0; t <= 6.0; t += 3.0) {
+        Dom::pspace_t ps_c = {1, {t, 2.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+        dom.add_<cons_t>(1.0 + t / 10.0, ps_c);
+    }
+
+    dom.calculate_all_sums();
+
+    // Both levels of the nested response from one sweep per consumer
+    const auto& csr = dom.interactions;
+    BOOST_TEST( csr.size() > 0 );
+    auto mass = [&](std::size_t j){ return dom.species.mass(j); };
+    std::vector<double> s0(dom.species.size(), 0.0), s1(dom.species.size(), 0.0);
+
+    for (std::size_t i = 0; i < dom.species.size(); ++i) {
+        if (dom.species.type[i] != 1) {
+            continue;
+        }
+        for (std::size_t k = csr.row[i]; k < csr.row[i + 1]; ++k) {
+            s1[i] += mass(csr.target[k]) * csr.weight[k][0];
+        }
+        for (std::size_t k = csr.row[i]; k < csr.row[i + 1]; ++k) {
+            const double tmp = csr.weight[k][0] / (1 + s1[i] * 0.5);
+            s0[i] += mass(csr.target[k]) * tmp;
+            s0[csr.target[k]] += mass(i) * tmp;
+        }
+    }
+
+    for (std::size_t i = 0; i < dom.species.size(); ++i) {
+        BOOST_TEST( dom.species.sum[0][i] == s0[i], boost::test_tools::tolerance(1e-12) );
+        if (dom.species.type[i] == 1) {
+            BOOST_TEST( dom.species.sum[1][i] == s1[i], boost::test_tools::tolerance(1e-12) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (fused_stages, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom, dom_ref;
+
+    dom.set_fused_stages(true);
+
+    std::vector<typename Dom::pspace_t> all;
+
+    for (auto d : {&dom, &dom_ref}) {
+        d->params = std::vector<double>({100.0, 100.0});
+        d->set_interaction_tolerance(1.0e-4);
+        all.clear();
+        for (double t = -20.0; t <= 20.0; t += 1.0) {
+            typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            d->template add_<pp_t>(5, ps);
+            all.push_back(ps);
+        }
+        for (double t = -10.0; t <= 10.0; t += 2.0) {
+            typename Dom::pspace_t ps_c = {1, {t, 3.0}, {0.7, 0.8, 0.1, 0.0}};
+            d->template add_<cons_t>(1, ps_c);
+            all.push_back(ps_c);
+        }
+    }
+
+    // Producers are read by consumers and themselves
+    BOOST_TEST( dom.buckets[dom.template get_bucket<cons_t>()]->stage_fused );
+    BOOST_TEST( !dom.buckets[dom.template get_bucket<pp_t>()]->stage_fused );
+
+    double dt = 0.01;
+    double dt_ref = 0.01;
+    for (int s = 0; s < 20; ++s) {
+        dt = dom.step(dt);
+        dt_ref = dom_ref.step(dt_ref);
+    }
+
+    // Same sums in the same order
+    BOOST_TEST( dt == dt_ref );
+    for (auto& ps : all) {
+        BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass() );
+    }
+}
+
+BOOST_AUTO_TEST_CASE (integrator_schemes)
+{
+    // Dormand-Prince with first same as last against Cash-Karp
+    using Dom = domain<double, 2, 0, 2, 0>;
+    using Dom_ref = domain<double, 0, 0, 2, 0>;
+
+    Dom dom;
+    Dom_ref dom_ref;
+
+    auto populate = [](auto& d) {
+        using D = std::remove_reference_t<decltype(d)>;
+        using pp_t = primary_producer<typename D::base_t, typename D::pspace_t, 0>;
+        using cons_t = consumer<typename D::base_t, typename D::pspace_t, 3>;
+
+        d.params = std::vector<double>({100.0, 100.0});
+        d.set_interaction_tolerance(1.0e-6);
+        for (double t = -4.0; t <= 4.0; t += 1.0) {
+            typename D::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            d.template add_<pp_t>(5.0 + t, ps);
+        }
+        typename D::pspace_t ps_c = {1, {0.0, 2.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+        d.template add_<cons_t>(1.0, ps_c);
+    };
+
+    populate(dom);
+    populate(dom_ref);
+
+    for (int i = 0; i < 50; i++) {
+        dom.step(0.01);
+        dom_ref.step(0.01);
+    }
+
+    // the derivatives of the last stage are stale for a new species
+    typename Dom::pspace_t ps_c = {1, {2.0, 2.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+    dom.add_<consumer<Dom::base_t, Dom::pspace_t, 3> >(1.0, ps_c);
+    dom_ref.add_<consumer<Dom_ref::base_t, Dom_ref::pspace_t, 3> >(1.0, ps_c);
+
+    for (int i = 0; i < 50; i++) {
+        dom.step(0.01);
+        dom_ref.step(0.01);
+    }
+
+    BOOST_TEST( dom[ps_c].get_mass() == dom_ref[ps_c].get_mass(), boost::test_tools::tolerance(1e-8) );
+    for (double t = -4.0; t <= 4.0; t += 1.0) {
+        typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+        BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass(), boost::test_tools::tolerance(1e-8) );
+    }
+}
+
+BOOST_AUTO_TEST_CASE (step_rejection)
+{
+    // a rejected step is repeated from the old values, also the stored first stage
+    using Dom = domain<double, 2, 0, 2, 0>;
+    using pp_t = primary_producer<Dom::base_t, Dom::pspace_t, 0>;
+    using cons_t = consumer<Dom::base_t, Dom::pspace_t, 3>;
+
+    Dom dom;
+    Dom dom_ref;
+
+    dom.set_error(1.0e-4);
+
+    for (auto* d : {&dom, &dom_ref}) {
+        d->params = std::vector<double>({100.0, 100.0});
+        d->set_interaction_tolerance(1.0e-6);
+        for (double t = -2.0; t <= 2.0; t += 1.0) {
+            Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            d->add_<pp_t>(5.0 + t, ps);
+        }
+        Dom::pspace_t ps_c = {1, {0.0, 2.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+        d->add_<cons_t>(1.0, ps_c);
+        d->step(0.01);
+    }
+
+    step_controller c;
+    c.type = step_controller::type_t::pi;
+    c.safety = 0.9;
+    c.min_dt = 1.0e-3;
+    dom.set_step_controller(c);
+
+    const double new_dt = dom.step(2.0);
+
+    BOOST_TEST( dom.get_step_controller().get_rejections() > 0 );
+    BOOST_TEST( dom.get_last_dt() < 2.0 );
+    BOOST_TEST( dom.get_last_dt() >= 1.0e-3 );
+    BOOST_TEST( new_dt <= dom.get_last_dt() );
+    BOOST_TEST( dom.get_time() == 0.01 + dom.get_last_dt(), boost::test_tools::tolerance(1e-12) );
+
+    dom_ref.step(dom.get_last_dt());
+
+    for (double t = -2.0; t <= 2.0; t += 1.0) {
+        Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+        BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass(), boost::test_tools::tolerance(1e-12) );
+    }
+
+    c.safety = 1.0;
+    BOOST_CHECK_THROW( dom.set_step_controller(c), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE (step_rejection_delay)
+{
+    // a rejected step also starts again from the old delay buffers of the consumers,
+    // with delays shorter and longer than the stages of a step
+    using Dom = domain<double, 0, 0, 2, 0>;
+    using pp_t = primary_producer<Dom::base_t, Dom::pspace_t, 0>;
+    using cons_t = consumer<Dom::base_t, Dom::pspace_t, 3>;
+
+    Dom::pspace_t ps_c = {1, {0.0, 2.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+
+    for (int bsize : {3, 20}) {
+        Dom dom;
+        Dom dom_ref;
+
+        dom.set_error(1.0e-4);
+
+        for (auto* d : {&dom, &dom_ref}) {
+            d->params = std::vector<double>({100.0, 100.0});
+            d->bsize = bsize;
+            d->set_interaction_tolerance(1.0e-6);
+            for (double t = -2.0; t <= 2.0; t += 1.0) {
+                Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+                d->add_<pp_t>(5.0 + t, ps);
+            }
+            d->add_<cons_t>(1.0, ps_c);
+            for (int i = 0; i < 5; i++) {
+                d->step(0.01);
+            }
+        }
+
+        step_controller c;
+        c.min_dt = 1.0e-3;
+        dom.set_step_controller(c);
+
+        dom.step(2.0);
+
+        BOOST_TEST( dom.get_step_controller().get_rejections() > 0 );
+
+        dom_ref.step(dom.get_last_dt());
+
+        // the delayed growth of the old steps reaches the consumers in the next ones
+        for (int i = 0; i < 5; i++) {
+            dom.step(1.0e-3);
+            dom_ref.step(1.0e-3);
+        }
+
+        BOOST_TEST( dom[ps_c].get_mass() == dom_ref[ps_c].get_mass(), boost::test_tools::tolerance(1e-12) );
+        for (double t = -2.0; t <= 2.0; t += 1.0) {
+            Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass(), boost::test_tools::tolerance(1e-12) );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (rosenbrock_community)
+{
+    // fast growing producers make the community stiff
+    using Dom = domain<double, 5, 0, 2, 0>;
+    using Dom_ref = domain<double, 2, 0, 2, 0>;
+
+    Dom dom;
+    Dom_ref dom_ref;
+
+    auto populate = [](auto& d) {
+        using D = std::remove_reference_t<decltype(d)>;
+        using pp_t = primary_producer<typename D::base_t, typename D::pspace_t, 0>;
+        using cons_t = consumer<typename D::base_t, typename D::pspace_t, 3>;
+
+        d.params = std::vector<double>({100.0, 100.0});
+        d.set_interaction_tolerance(1.0e-6);
+        d.set_error(1.0e-4);
+        for (double t = -4.0; t <= 4.0; t += 1.0) {
+            typename D::pspace_t ps = {0, {t, 0}, {1000, 100.0}};
+            d.template add_<pp_t>(5.0 + t, ps);
+        }
+        for (double t = -2.0; t <= 2.0; t += 2.0) {
+            typename D::pspace_t ps_c = {1, {t, 2.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+            d.template add_<cons_t>(1.0, ps_c);
+        }
+    };
+
+    auto integrate = [](auto& d, double t_end) {
+        std::size_t steps = 0;
+        double dt = 1.0e-3;
+        while (d.get_time() < t_end - 1.0e-12) {
+            dt = std::min(d.step(std::min(dt, t_end - d.get_time())), 1.0);
+            ++steps;
+        }
+        return steps;
+    };
+
+    populate(dom);
+    populate(dom_ref);
+
+    dom.set_jacobian_interval(5);
+
+    const std::size_t steps = integrate(dom, 5.0);
+    const std::size_t steps_ref = integrate(dom_ref, 5.0);
+
+    BOOST_TEST( steps * 4 < steps_ref );
+
+    // the Jacobian is reused over several steps
+    const auto& jac = dom.get_jacobian();
+    BOOST_TEST( jac.evaluations < steps );
+    BOOST_TEST( jac.evaluations > 0 );
+    BOOST_TEST( jac.size() == 12 );
+
+    for (double t = -4.0; t <= 4.0; t += 1.0) {
+        typename Dom::pspace_t ps = {0, {t, 0}, {1000, 100.0}};
+        BOOST_TEST( dom[ps].get_mass() == dom_ref[ps].get_mass(), boost::test_tools::tolerance(1e-3) );
+    }
+    for (double t = -2.0; t <= 2.0; t += 2.0) {
+        typename Dom::pspace_t ps_c = {1, {t, 2.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+        BOOST_TEST( dom[ps_c].get_mass() == dom_ref[ps_c].get_mass(), boost::test_tools::tolerance(1e-3) );
+    }
+
+    BOOST_CHECK_THROW( dom.set_jacobian_interval(0), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE (rosenbrock_nan_rejection)
+{
+    // a non-finite result is no extinction, the step is repeated with a smaller one
+    using Dom = domain<double, 5, 0, 2, 0>;
+    using pp_t = primary_producer<Dom::base_t, Dom::pspace_t, 0>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+    dom.set_interaction_tolerance(1.0e-6);
+    dom.set_error(1.0e-4);
+
+    step_controller c;
+    c.min_factor = 0.2;
+    c.min_dt = 1.0e-3;
+    dom.set_step_controller(c);
+
+    Dom::pspace_t ps = {0, {0.0, 0}, {10, 100.0}};
+    Dom::pspace_t ps_nan = {0, {100.0, 0}, {10, 100.0}};
+    dom.add_<pp_t>(5.0, ps);
+    dom.add_<pp_t>(std::numeric_limits<double>::quiet_NaN(), ps_nan);
+
+    // 0.01 and 0.002 are rejected, at min_dt the step can't be repeated
+    BOOST_CHECK_THROW( dom.step(0.01), std::runtime_error );
+    BOOST_TEST( dom.get_step_controller().get_rejections() == 2u );
+    BOOST_TEST( dom.get_dead_fraction() == 0.0 );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (trait_update, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom, dom_ref;
+
+    typename Dom::pspace_t ps_old = {1, {-8.0, 2.0}, {0.7, 0.8, 0.1, 0.0}};
+    typename Dom::pspace_t ps_new = {1, {5.5, 1.5}, {0.7, 0.8, 0.1, 0.0}};
+
+    for (auto d : {&dom, &dom_ref}) {
+        d->params = std::vector<double>({100.0, 100.0});
+        d->set_interaction_tolerance(1.0e-4);
+        for (double t = -20.0; t <= 20.0; t += 1.0) {
+            typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+            d->template add_<pp_t>(5, ps);
+        }
+        d->template add_<cons_t>(1, d == &dom ? ps_old : ps_new);
+        for (double t = -10.0; t <= 10.0; t += 5.0) {
+            typename Dom::pspace_t ps_c = {1, {t, 2.0}, {0.7, 0.8, 0.1, 0.0}};
+            d->template add_<cons_t>(1, ps_c);
+        }
+    }
+
+    auto v = dom.psm[ps_old];
+    dom.set_trait(v, ps_new.trait);
+
+    // Re-keyed
+    BOOST_TEST( dom.psm.count(ps_old) == 0 );
+    BOOST_TEST( dom.psm[ps_new] == v );
+    BOOST_TEST( dom.species.trait[dom[v].idx][0] == 5.5 );
+
+    // Derived constants follow the new niche width
+    BOOST_TEST( dom[v].org->interaction_radius(1.0e-4, 0) == dom_ref[ps_new].org->interaction_radius(1.0e-4, 0) );
+
+    // Same edges as if added with the new trait
+    auto edges = [](Dom& d) {
+        std::multiset<std::tuple<double, double, double> > e;
+        for (auto ed : boost::make_iterator_range(boost::edges(d.graph))) {
+            e.emplace(d.graph[source(ed, d.graph)].org->parameters.trait[0],
+                      d.graph[target(ed, d.graph)].org->parameters.trait[0],
+                      d.graph[ed].interaction_vector[0]);
+        }
+        return e;
+    };
+    BOOST_TEST( (edges(dom) == edges(dom_ref)) );
+
+    // A taken parameter space is rejected
+    typename Dom::pspace_t ps_taken = {1, {0.0, 2.0}, {0.7, 0.8, 0.1, 0.0}};
+    BOOST_CHECK_THROW( dom.set_parameters(v, ps_taken), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (trait_update_raised_tolerance, Dom, Doms)
+{
+    // edges added with a lower tolerance reach beyond the current candidate window
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+    dom.set_interaction_tolerance(1.0e-6);
+
+    for (double t = -20.0; t <= 20.0; t += 1.0) {
+        typename Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+        dom.template add_<pp_t>(5, ps);
+    }
+    for (double t = -10.0; t <= 10.0; t += 5.0) {
+        typename Dom::pspace_t ps_c = {1, {t, 2.0}, {0.7, 0.8, 0.1, 0.0}};
+        dom.template add_<cons_t>(1, ps_c);
+    }
+
+    dom.set_interaction_tolerance(1.0e-1);
+
+    typename Dom::pspace_t ps = {0, {0.0, 0}, {10, 100.0}};
+    auto v = dom.psm[ps];
+    dom.set_trait(v, {15.5, 0});
+
+    // no edge keeps a coefficient of the old trait
+    std::size_t in_edges = 0;
+    for (auto ed : boost::make_iterator_range(boost::edges(dom.graph))) {
+        if (target(ed, dom.graph) == v) {
+            ++in_edges;
+            BOOST_TEST( dom.graph[ed].interaction_vector
+                        == dom.graph[source(ed, dom.graph)].org->calc_interaction_coeff(dom[v].org) );
+        }
+    }
+    BOOST_TEST( in_edges > 0u );
+}
+
+BOOST_AUTO_TEST_CASE (trait_update_drifted_keys)
+{
+    // producers with a seasonal carrying capacity, see compaction_drifted_keys
+    using Dom = domain<double, 0, 0, 1, 2>;
+    using pp_t = primary_producer<Dom::base_t, Dom::pspace_t, 0>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 30.0, 20.0, 5.0, 0.5});
+
+    Dom::pspace_t ps_old = {0, {-1, 0}, {10, 100.0}};
+    Dom::pspace_t ps_new = {0, {2, 0}, {10, 100.0}};
+    Dom::pspace_t ps_other = {0, {1, 0}, {10, 100.0}};
+
+    dom.add_<pp_t>(5, ps_old);
+    dom.add_<pp_t>(5, ps_other);
+
+    for (int i = 0; i < 10; i++) {
+        dom.step(0.01);
+    }
+
+    auto v = dom.psm[ps_old];
+    BOOST_TEST( !(dom[v].org->parameters == ps_old) );
+
+    // the own key is no change
+    dom.set_parameters(v, ps_old);
+    BOOST_TEST( dom.psm.size() == 2 );
+
+    dom.set_trait(v, ps_new.trait);
+
+    BOOST_TEST( dom.psm.size() == 2 );
+    BOOST_TEST( dom.psm.count(ps_old) == 0 );
+    BOOST_TEST( dom.psm.count(ps_new) == 1 );
+    BOOST_TEST( dom[ps_new].get_trait() == ps_new.trait );
+
+    // the old parameters are free for a new species
+    dom.add_<pp_t>(1, ps_old);
+    BOOST_TEST( num_vertices(dom.graph) == 3 );
+    BOOST_TEST( dom[ps_old].get_mass() == 1.0 );
+}
+
+BOOST_AUTO_TEST_CASE (batch_kernels)
+{
+    // Fast approximations stay within the documented bounds
+    double max_exp = 0.0;
+    for (double x = -708.0; x < 709.0; x += 0.0137) {
+        max_exp = std::max(max_exp, std::abs(fast_exp(x) / std::exp(x) - 1.0));
+    }
+    BOOST_TEST( max_exp < 1e-15 );
+    BOOST_TEST( fast_exp(-800.0) == 0.0 );
+
+    double max_cos = 0.0;
+    for (double x = -1e5; x < 1e5; x += 0.731) {
+        max_cos = std::max(max_cos, std::abs(fast_cos(x) - std::cos(x)));
+    }
+    BOOST_TEST( max_cos < 1e-15 );
+
+    // Batches agree with the scalar functions
+    using Dom = domain<double, 0, 0, 2, 3>;
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 0>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 30.0, 20.0, 5.0, 0.5});
+
+    std::vector<double> z;
+    for (double t = -50.0; t < 50.0; t += 0.37) {
+        z.push_back(t);
+    }
+    std::vector<double> s(z.size());
+    dom.S(z.data(), z.size(), 0.25, s.data());
+
+    for (std::size_t i = 0; i < z.size(); ++i) {
+        BOOST_TEST( s[i] == dom.S(z[i], 0.25) );
+    }
+
+    typename Dom::pspace_t ps_c = {1, {1.5, 2}, {0.7, 0.8, 5.0, 0.0}};
+    dom.template add_<cons_t>(5, ps_c);
+    std::vector<typename Dom::org_t*> others;
+    for (std::size_t i = 0; i < 20; ++i) {
+        // every fourth partner is a consumer
+        if (i % 4 == 0) {
+            typename Dom::pspace_t ps = {1, {z[i] / 5.0, 2}, {0.7, 0.8, 5.0, 0.0}};
+            others.push_back(&*dom.template add_<cons_t>(5, ps).org);
+        } else {
+            typename Dom::pspace_t ps = {0, {z[i] / 5.0, 0}, {10, 100.0}};
+            others.push_back(&*dom.template add_<pp_t>(5, ps).org);
+        }
+    }
+    auto& c = dom[ps_c];
+
+    std::vector<typename Dom::edge_cont> out(others.size());
+    c.org->calc_interaction_coeffs(others.data(), others.size(), out.data());
+
+    for (std::size_t i = 0; i < others.size(); ++i) {
+        BOOST_TEST( out[i][0] == c.org->calc_interaction_coeff(*others[i])[0] );
+    }
+}
+
+#ifdef MULAN_USE_FFTW
+BOOST_AUTO_TEST_CASE (lattice_sums_fft)
+{
+    using Dom = domain<double, 0, 0, 2, 0>;
+    using pp_t = primary_producer<Dom::base_t, Dom::pspace_t, 1>;
+    using cons_t = consumer<Dom::base_t, Dom::pspace_t, 3>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+
+    // all edges, the convolution does not cut the kernel
+    dom.set_interaction_tolerance(0.0);
+
+    for (double t = -40.0; t <= 40.0; t += 1.0) {
+        Dom::pspace_t ps = {0, {t, 0}, {10, 100.0}};
+        dom.add_<pp_t>(5.0 + t / 10.0, ps);
+    }
+    for (double t = -9.0; t <= 9.0; t += 3.0) {
+        Dom::pspace_t ps_c = {1, {t, 2.0 + std::abs(t) / 3.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+        dom.add_<cons_t>(1.0 + t / 10.0, ps_c);
+    }
+
+    dom.calculate_all_sums();
+    auto edges = dom.species.sum;
+
+    for (auto& level : dom.species.sum) {
+        std::fill(level.begin(), level.end(), 0.0);
+    }
+
+    lattice_sums<Dom::base_t, pp_t, cons_t> engine;
+    BOOST_TEST( engine.calculate_sums(dom) );
+
+    // Same sums as the edges up to the round off of the FFT
+    for (std::size_t l = 0; l < 2; ++l) {
+        for (std::size_t i = 0; i < dom.species.size(); ++i) {
+            BOOST_TEST( std::abs(dom.species.sum[l][i] - edges[l][i]) < 1e-10 * (1 + std::abs(edges[l][i])) );
+        }
+    }
+
+    // Off the lattice the domain falls back to the edges
+    Dom::pspace_t ps_c = {1, {0.5, 2.0}, {0.7, 0.8, 0.1, 0.0, 0.5}};
+    dom.add_<cons_t>(1.0, ps_c);
+    dom.update_active_edges();
+
+    for (auto& level : dom.species.sum) {
+        std::fill(level.begin(), level.end(), 0.0);
+    }
+    BOOST_TEST( !engine.calculate_sums(dom) );
+    BOOST_TEST( dom.species.sum[0][0] == 0.0 );
+}
+#endif
+
+BOOST_AUTO_TEST_CASE_TEMPLATE (organism_pool, Dom, Doms)
+{
+    using pp_t = primary_producer<typename Dom::base_t, typename Dom::pspace_t, 0>;
+    using cons_t = consumer<typename Dom::base_t, typename Dom::pspace_t, 1>;
+
+    Dom dom;
+    dom.params = std::vector<double>({100.0, 100.0});
+
+    typename Dom::pspace_t ps = {0, {0, 0}, {10, 100.0}};
+    dom.template add_<pp_t>(5, ps);
+
+    for (double t = 0.0; t < 10.0; t += 1.0) {
+        typename Dom::pspace_t ps_c = {1, {t, 2}, {0.7, 0.8, 5.0, 0.0}};
+        dom.template add_<cons_t>(5, ps_c);
+    }
+
+    auto& arena = *dom.template get_arena<cons_t>();
+
+    // Organisms of one type share an arena
+    BOOST_TEST( dom.template get_arena<pp_t>()->size() == 1 );
+    BOOST_TEST( arena.size() == 10 );
+
+    auto capacity = arena.capacity();
+
+    // Blocks of removed species are reused
+    for (std::size_t i = 1; i < dom.species.size(); ++i) {
+        dom.species.deactivate(i);
+    }
+    dom.compact();
+    BOOST_TEST( arena.size() == 0 );
+
+    for (double t = 0.0; t < 10.0; t += 1.0) {
+        typename Dom::pspace_t ps_c = {1, {-t, 2}, {0.7, 0.8, 5.0, 0.0}};
+        dom.template add_<cons_t>(5, ps_c);
+    }
+    BOOST_TEST( arena.size() == 10 );
+    BOOST_TEST( arena.capacity() == capacity );
+}
+
+
 } // namespace MuLAN_MA
 } // namespace Models
 } // namespace Utopia
\ No newline at end of file
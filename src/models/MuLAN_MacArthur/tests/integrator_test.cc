@@ -41,6 +41,15 @@ public:
 
     };
 
+    /**
+     * @brief Construct a new organism on a slot of a shared store
+     * 
+     * @param store 
+     */
+    explicit dummy_organism(integrator_store<currency>& store) : integrator(*this, store){
+
+    };
+
     /**
      * @brief Destroy the organism base object
      * 
@@ -86,6 +95,14 @@ template <typename DOM_T>
 class dummy_organism_1 : public dummy_organism<DOM_T> {
 public:
     using currency = typename DOM_T::integrator_t::currency;
+    using dummy_organism<DOM_T>::dummy_organism;
+
+    /**
+     * @brief Number of evaluations of dxdt
+     * 
+     */
+    inline static long evaluations = 0;
+
     /**
      * @brief Calculate the change rate
      * @details May depend on parameters, current value x and the integrator (e.g. sums, ..)
@@ -95,6 +112,8 @@ public:
      */
     virtual currency dxdt(const currency& x, const double tpdt) {
 
+        evaluations++;
+
         currency logistic_term = (x)/100.0;
 
         return x * (1 - logistic_term);
@@ -103,6 +122,23 @@ public:
 };
 
 
+/**
+ * @brief dummy organism relaxing fast to a fixed value, stiff for explicit schemes
+ * 
+ * @tparam DOM_T 
+ */
+template <typename DOM_T>
+class dummy_organism_2 : public dummy_organism<DOM_T> {
+public:
+    using currency = typename DOM_T::integrator_t::currency;
+    using dummy_organism<DOM_T>::dummy_organism;
+
+    virtual currency dxdt(const currency& x, const double /*tpdt*/) {
+        return -1000.0 * (x - 50.0) + 0.5 * x;
+    };
+
+};
+
 /**
  * @brief Dummy domain for euler
  * 
@@ -134,7 +170,43 @@ public:
 
     dummy_domain_rkck() {
         this->orga.set_value(1.0);
-        this->orga.integrator.set_beta(0.95);
+    }
+};
+
+/**
+ * @brief Dummy domain for the other explicit Runge-Kutta schemes
+ * 
+ * @tparam INTEGRATOR Selector of integrator_of
+ */
+template <int INTEGRATOR>
+class dummy_domain_rk {
+public:
+    using org_t = dummy_organism_1<dummy_domain_rk>;
+    using integrator_t = integrator_of<INTEGRATOR, double, dummy_organism<dummy_domain_rk> >;
+    static constexpr typename integrator_t::currency error = 0.1;
+
+    org_t orga;
+
+    dummy_domain_rk() {
+        this->orga.set_value(1.0);
+    }
+};
+
+/**
+ * @brief Dummy domain for the stiff problem
+ * 
+ * @tparam INTEGRATOR Selector of integrator_of
+ */
+template <int INTEGRATOR>
+class dummy_domain_stiff {
+public:
+    using org_t = dummy_organism_2<dummy_domain_stiff>;
+    using integrator_t = integrator_of<INTEGRATOR, double, dummy_organism<dummy_domain_stiff> >;
+
+    org_t orga;
+
+    dummy_domain_stiff() {
+        this->orga.set_value(1.0);
     }
 };
 
@@ -150,13 +222,19 @@ double exact_value(double t) {
 }
 
 
-using AllDoms = boost::mpl::list<dummy_domain_euler, dummy_domain_rkck>;
+using AllDoms = boost::mpl::list<dummy_domain_euler, dummy_domain_rkck, dummy_domain_rk<2>, dummy_domain_rk<3>, dummy_domain_rk<4> >;
+
+// the Rosenbrock stage updates need the Jacobian of the store
+using StepDoms = boost::mpl::list<dummy_domain_euler, dummy_domain_rkck, dummy_domain_rk<2>, dummy_domain_rk<3>, dummy_domain_rk<4>, dummy_domain_rk<5> >;
 
 // Test the integrators 
-BOOST_AUTO_TEST_CASE_TEMPLATE (case1, ThisDom, AllDoms)
+BOOST_AUTO_TEST_CASE_TEMPLATE (case1, ThisDom, StepDoms)
 {
     ThisDom dom;
 
+    step_controller controller;
+    const char active = true;
+
     auto last_value = dom.orga.get_value();
     
     double dt = 0.01;
@@ -177,7 +255,13 @@ BOOST_AUTO_TEST_CASE_TEMPLATE (case1, ThisDom, AllDoms)
 
                 dom.orga.integrator.calc_new_step_size_s(dt, new_dt);
                 
-                ThisDom::integrator_t::calc_new_step_size(dt, new_dt);
+                if (!ThisDom::integrator_t::calc_new_step_size(dom.orga.integrator.get_store(), &active, dt, new_dt, controller)) {
+                    // repeat the step from the old value
+                    dom.orga.set_value(last_value);
+                    dt = new_dt;
+                    new_dt = std::numeric_limits<double>::max();
+                    i = -1;
+                }
 
             } else  {
 
@@ -192,8 +276,9 @@ BOOST_AUTO_TEST_CASE_TEMPLATE (case1, ThisDom, AllDoms)
 
         t += dt;
 
+        // like the model, which integrates in chunks of dt2
         if (new_dt != std::numeric_limits<double>::max()){
-            dt = new_dt;
+            dt = std::min(new_dt, 1.0);
         }
 
         // Test if solution is monotonically increasing
@@ -206,6 +291,321 @@ BOOST_AUTO_TEST_CASE_TEMPLATE (case1, ThisDom, AllDoms)
     }
 }
 
+// Batched stepping of a shared store gives the same values as stepping each organism
+BOOST_AUTO_TEST_CASE_TEMPLATE (batched, ThisDom, AllDoms)
+{
+    using org_t = typename ThisDom::org_t;
+    using integrator_t = typename ThisDom::integrator_t;
+
+    integrator_store<double> store;
+    std::vector<std::unique_ptr<org_t> > batch;
+    std::vector<std::unique_ptr<org_t> > single;
+
+    for (int n = 0; n < 11; ++n) {
+        batch.push_back(std::make_unique<org_t>(store));
+        single.push_back(std::make_unique<org_t>());
+        batch.back()->set_value(1.0 + n);
+        single.back()->set_value(1.0 + n);
+    }
+
+    // inactive slots are left untouched
+    std::vector<char> active(batch.size(), true);
+    active[3] = false;
+
+    const double dt = 0.01;
+
+    for (size_t steps = 0; steps < 100; steps++) {
+        for (int i = 0; i < integrator_t::steps; i++) {
+            for (std::size_t n = 0; n < batch.size(); ++n) {
+                if (active[n]) {
+                    batch[n]->integrator.derive(dt);
+                    single[n]->integrator.step(dt);
+                }
+            }
+            integrator_t::stage_update(store, active.data(), i, dt);
+        }
+    }
+
+    for (std::size_t n = 0; n < batch.size(); ++n) {
+        BOOST_TEST(batch[n]->get_value() == single[n]->get_value());
+        BOOST_TEST(batch[n]->integrator.get_error() == single[n]->integrator.get_error());
+    }
+    BOOST_TEST(batch[3]->get_value() == 4.0);
+}
+
+// Dormand-Prince reuses the last derivative of a step as the first of the next one
+BOOST_AUTO_TEST_CASE (first_same_as_last)
+{
+    using ThisDom = dummy_domain_rk<2>;
+    using org_t = ThisDom::org_t;
+
+    ThisDom dom;
+
+    const double dt = 0.01;
+    double t = 0.0;
+
+    org_t::evaluations = 0;
+
+    for (size_t steps = 0; steps < 100; steps++) {
+        for (int i = 0; i < ThisDom::integrator_t::steps; i++) {
+            dom.orga.integrator.step(dt);
+        }
+        t += dt;
+    }
+
+    BOOST_TEST(org_t::evaluations == 7 + 99 * 6);
+    BOOST_TEST(std::abs(exact_value(t) - dom.orga.get_value()) < 1e-8);
+
+    // a new value invalidates the stored derivative
+    dom.orga.set_value(1.0);
+    org_t::evaluations = 0;
+    for (int i = 0; i < ThisDom::integrator_t::steps; i++) {
+        dom.orga.integrator.step(dt);
+    }
+    BOOST_TEST(org_t::evaluations == 7);
+    BOOST_TEST(std::abs(exact_value(dt) - dom.orga.get_value()) < 1e-12);
+}
+
+// Steps above the tolerance are rejected, the controllers propose smaller steps
+BOOST_AUTO_TEST_CASE (step_rejection)
+{
+    using ThisDom = dummy_domain_rk<2>;
+    using integrator_t = ThisDom::integrator_t;
+
+    const char active = true;
+
+    for (auto type : {step_controller::type_t::integral, step_controller::type_t::pi, step_controller::type_t::gustafsson}) {
+
+        ThisDom dom;
+
+        step_controller controller;
+        controller.type = type;
+        controller.min_dt = 1e-3;
+
+        // far too large for the error of 0.1
+        double dt = 5.0;
+        double t = 0.0;
+        double value = dom.orga.get_value();
+
+        std::size_t steps = 0;
+
+        while (t < 10.0) {
+            double new_dt = std::numeric_limits<double>::max();
+
+            for (int i = 0; i < integrator_t::steps; i++) {
+                dom.orga.integrator.step(dt);
+            }
+
+            if (!integrator_t::calc_new_step_size(dom.orga.integrator.get_store(), &active, dt, new_dt, controller)) {
+                BOOST_TEST(new_dt < dt);
+                dom.orga.set_value(value);
+                dt = new_dt;
+                continue;
+            }
+
+            BOOST_TEST(std::abs(dom.orga.integrator.get_error()) <= integrator_t::w_error);
+
+            t += dt;
+            value = dom.orga.get_value();
+            dt = std::min(new_dt, 10.0 - t);
+            ++steps;
+        }
+
+        BOOST_TEST(controller.get_rejections() > 0);
+        BOOST_TEST(std::abs(exact_value(t) - dom.orga.get_value()) < 0.5);
+        BOOST_TEST(steps < 100);
+    }
+
+    // steps of min_dt are accepted whatever the error
+    ThisDom dom;
+    step_controller controller;
+    controller.min_dt = 5.0;
+
+    double new_dt = std::numeric_limits<double>::max();
+    for (int i = 0; i < integrator_t::steps; i++) {
+        dom.orga.integrator.step(5.0);
+    }
+    BOOST_TEST(std::abs(dom.orga.integrator.get_error()) > integrator_t::w_error);
+    BOOST_TEST(integrator_t::calc_new_step_size(dom.orga.integrator.get_store(), &active, 5.0, new_dt, controller));
+    BOOST_TEST(new_dt == 5.0);
+    BOOST_TEST(controller.get_rejections() == 0);
+}
+
+// Errors relative to atol + rtol * |x| in the max or RMS norm over the species
+BOOST_AUTO_TEST_CASE (error_norm)
+{
+    using integrator_t = dummy_domain_rk<2>::integrator_t;
+
+    integrator_store<double> store;
+    store.reserve_stages(integrator_t::steps);
+    for (int n = 0; n < 3; ++n) {
+        store.emplace_back();
+    }
+
+    // a large producer, a small one and one collapsing
+    store.xs[0] = {1000.0, 1.0, 1e-6};
+    store.error = {0.5, 0.05, 0.3};
+
+    std::vector<char> active = {true, true, false};
+
+    const double atol = integrator_t::w_error;
+    const double dt = 0.1;
+
+    // error norm seen by the integral controller
+    auto norm = [&](step_controller c, const char* slots) {
+        double new_dt = std::numeric_limits<double>::max();
+        integrator_t::calc_new_step_size(store, slots, dt, new_dt, c);
+        return std::pow(c.safety * dt / new_dt, 5.0);
+    };
+
+    step_controller c;
+    c.min_factor = 1e-3;
+    c.max_factor = 1e3;
+
+    BOOST_TEST( norm(c, active.data()) == 0.5 / atol, boost::test_tools::tolerance(1e-12) );
+
+    c.rtol = 1e-3;
+    const double q0 = 0.5 / (atol + 1.0);
+    const double q1 = 0.05 / (atol + 1e-3);
+    BOOST_TEST( norm(c, active.data()) == std::max(q0, q1), boost::test_tools::tolerance(1e-12) );
+
+    c.norm = step_controller::norm_t::rms;
+    BOOST_TEST( norm(c, active.data()) == std::sqrt((q0 * q0 + q1 * q1) / 2.0), boost::test_tools::tolerance(1e-12) );
+
+    // the collapsing species would reject the step
+    active[2] = true;
+    double new_dt = std::numeric_limits<double>::max();
+    BOOST_TEST( !integrator_t::calc_new_step_size(store, active.data(), dt, new_dt, c) );
+    active[2] = false;
+    BOOST_TEST( integrator_t::calc_new_step_size(store, active.data(), dt, new_dt, c) );
+
+    BOOST_CHECK_THROW( step_controller::norm_of("l1"), std::invalid_argument );
+}
+
+// Stiff relaxation: the explicit schemes are bound by stability, Rosenbrock by accuracy
+BOOST_AUTO_TEST_CASE (stiff)
+{
+    auto integrate = [](auto& dom, std::size_t& steps) {
+        using integrator_t = typename std::remove_reference_t<decltype(dom)>::integrator_t;
+
+        const char active = true;
+        step_controller controller;
+        controller.type = step_controller::type_t::pi;
+        integrator_t::w_error = 1e-4;
+
+        double dt = 1e-3;
+        double t = 0.0;
+        double value = dom.orga.get_value();
+
+        while (t < 10.0) {
+            double new_dt = std::numeric_limits<double>::max();
+
+            for (int i = 0; i < integrator_t::steps; i++) {
+                dom.orga.integrator.step(dt);
+            }
+
+            if (!integrator_t::calc_new_step_size(dom.orga.integrator.get_store(), &active, dt, new_dt, controller)) {
+                dom.orga.set_value(value);
+                dt = new_dt;
+                continue;
+            }
+
+            t += dt;
+            value = dom.orga.get_value();
+            dt = std::min(new_dt, 10.0 - t);
+            ++steps;
+        }
+
+        return value;
+    };
+
+    // x' = -999.5 (x - 50000 / 999.5)
+    const double fixpoint = 50000.0 / 999.5;
+
+    dummy_domain_stiff<0> explicit_dom;
+    dummy_domain_stiff<5> implicit_dom;
+
+    std::size_t explicit_steps = 0;
+    std::size_t implicit_steps = 0;
+
+    BOOST_TEST( integrate(explicit_dom, explicit_steps) == fixpoint, boost::test_tools::tolerance(1e-4) );
+    BOOST_TEST( integrate(implicit_dom, implicit_steps) == fixpoint, boost::test_tools::tolerance(1e-4) );
+
+    BOOST_TEST( explicit_steps > 1000 );
+    BOOST_TEST( implicit_steps < explicit_steps / 20 );
+}
+
+// Finite difference columns by color and the solution of shift * I - J
+BOOST_AUTO_TEST_CASE (sparse_jacobian_solve)
+{
+    const std::size_t n = 7;
+
+    // a chain, a star around slot 6 and slot 2 left out
+    std::vector<std::pair<std::size_t, std::size_t> > pairs = {{0, 1}, {1, 2}, {2, 3}, {3, 4}, {6, 0}, {6, 3}, {6, 5}};
+    std::vector<char> in_color(n, true);
+    in_color[2] = false;
+
+    sparse_jacobian<double> jac;
+    jac.set_pattern(n, pairs, in_color);
+
+    std::vector<std::vector<double> > dense(n, std::vector<double>(n, 0.0));
+    for (std::size_t i = 0; i < n; ++i) {
+        dense[i][i] = -1.0 - double(i);
+    }
+    for (const auto& [i, j] : pairs) {
+        if (in_color[i] && in_color[j]) {
+            dense[i][j] = 0.5 + 0.1 * double(i);
+            dense[j][i] = -0.3 + 0.2 * double(j);
+        }
+    }
+
+    // columns of one color share no row, one evaluation per color
+    std::vector<char> colored(n, false);
+    for (std::size_t c = 0; c < jac.n_colors(); ++c) {
+        std::vector<double> f0(n, 1.0);
+        std::vector<double> f1(n, 1.0);
+        std::vector<char> hit(n, false);
+        for (auto j : jac.color(c)) {
+            colored[j] = true;
+            for (std::size_t i = 0; i < n; ++i) {
+                if (dense[i][j] != 0.0) {
+                    BOOST_TEST(!hit[i]);
+                    hit[i] = true;
+                    f1[i] += 0.5 * dense[i][j];
+                }
+            }
+        }
+        for (auto j : jac.color(c)) {
+            jac.set_column(j, f0.data(), f1.data(), 0.5);
+        }
+    }
+    BOOST_TEST(jac.n_colors() < n - 1);
+    BOOST_TEST(!colored[2]);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+            BOOST_TEST(jac(i, j) == (i == 2 || j == 2 ? 0.0 : dense[i][j]), boost::test_tools::tolerance(1e-12));
+        }
+    }
+
+    const double shift = 3.0;
+    jac.factor(shift);
+    jac.factor(shift);
+    BOOST_TEST(jac.factorizations == 1);
+
+    std::vector<double> b = {1.0, -2.0, 3.0, 0.5, 4.0, -1.0, 2.0};
+    std::vector<double> x = b;
+    jac.solve(x.data());
+
+    for (std::size_t i = 0; i < n; ++i) {
+        double r = shift * x[i];
+        for (std::size_t j = 0; j < n; ++j) {
+            r -= jac(i, j) * x[j];
+        }
+        BOOST_TEST(r == b[i], boost::test_tools::tolerance(1e-12));
+    }
+}
+
 
 } // namespace MuLAN_MA
 } // namespace Models